@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CircuitCore.h"
+#include "CircuitBinary.h"
+#include "CircuitCache.h"
+#include "CircuitTrace.h"
+#include "NetlistParser.h"
+#include "ResultsWriter.h"
+
+/*
+	Solves netlists without a window, on every core:
+
+		BatchSolver [options] netlist... (- or nothing reads standard input, @list reads paths from a file)
+
+		-j threads      how many circuits are solved at once (all cores by default)
+		-o path         where results go (standard output by default)
+		--binary        results in the binary format of ResultsWriter instead of CSV
+		--series        solve() instead of solveNodal(), only for series and parallel circuits
+		--quiet         no results, only the stats
+		--cache MB      skips circuits solved before in the batch (renamed ones too), keeping up to MB megabytes
+		--trace path    writes a Chrome trace of reading and solving every input, per thread, to path
+		--memory        measures each circuit (see CircuitCore::getMemoryStats) and reports the largest peak,
+		                without the nodal equations of circuits the cache solves
+
+	Files ending in .ncb are loaded with CircuitBinary, everything else is read as a netlist.
+	The sample column of the results is the index of the netlist in the order given.
+	Failures and the stats go to standard error. Build it without the GUI:
+
+		g++ -O2 -o BatchSolver BatchSolver.cpp CircuitCore.cpp CircuitNodal.cpp CircuitOrdering.cpp Subcircuit.cpp CircuitCodeGen.cpp CircuitTrace.cpp NetlistParser.cpp CircuitBinary.cpp CircuitCache.cpp ResultsWriter.cpp -lpthread -std=c++17
+*/
+
+struct BatchOptions
+{
+	int threads = 0;
+	std::string output;
+	bool binary = false;
+	bool series = false;
+	bool quiet = false;
+	int cacheMegabytes = 0;
+	std::string trace;
+	bool memory = false;
+	std::vector<std::string> inputs;
+};
+
+// What all the workers did together
+struct BatchStats
+{
+	std::atomic<long long> solved{ 0 };
+	std::atomic<long long> failed{ 0 };
+	std::atomic<long long> elements{ 0 };
+	std::atomic<long long> readNanoseconds{ 0 };
+	std::atomic<long long> solveNanoseconds{ 0 };
+	std::atomic<size_t> peakBytes{ 0 };
+};
+
+static long long nanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool endsWith(const std::string& text, const std::string& end)
+{
+	return text.size() >= end.size() && text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+static bool readOptions(int argc, char** argv, BatchOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if ((argument == "-j" || argument == "-o" || argument == "--cache" || argument == "--trace") && i + 1 < argc)
+		{
+			if (argument == "-j")
+				options.threads = std::atoi(argv[++i]);
+			else if (argument == "--cache")
+				options.cacheMegabytes = std::atoi(argv[++i]);
+			else if (argument == "--trace")
+				options.trace = argv[++i];
+			else
+				options.output = argv[++i];
+		}
+		else if (argument == "--binary")
+			options.binary = true;
+		else if (argument == "--series")
+			options.series = true;
+		else if (argument == "--quiet")
+			options.quiet = true;
+		else if (argument == "--memory")
+			options.memory = true;
+		else if (argument[0] == '@')
+		{
+			std::ifstream list(argument.substr(1));
+			if (!list)
+			{
+				std::cerr << "Cannot open " << argument.substr(1) << "\n";
+				return false;
+			}
+			for (std::string path; std::getline(list, path);)
+				if (!path.empty())
+					options.inputs.push_back(path);
+		}
+		else if (argument.size() > 1 && argument[0] == '-')
+		{
+			std::cerr << "Unknown option " << argument << "\n";
+			return false;
+		}
+		else
+			options.inputs.push_back(argument);
+	}
+
+	if (options.inputs.empty())
+		options.inputs.push_back("-");
+	if (options.threads <= 0)
+		options.threads = std::max(1u, std::thread::hardware_concurrency());
+	return true;
+}
+
+static void reportFailure(const std::string& input, const CircuitBase::Outcome& outcome, long long line, std::mutex& mutex)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cerr << input << ": error " << outcome.error;
+	if (line > 0)
+		std::cerr << " at line " << line;
+	if (!outcome.element.empty())
+		std::cerr << " element " << outcome.element;
+	if (!outcome.node.empty())
+		std::cerr << " node " << outcome.node;
+	std::cerr << "\n";
+}
+
+// Reads and solves one input, and hands its results to the writer
+static void solveInput(const BatchOptions& options, int index, CircuitCache* cache, ResultsWriter* writer, std::mutex& writerMutex, std::mutex& errorMutex, BatchStats& stats)
+{
+	const std::string& input = options.inputs[index];
+	CircuitCore circuit;
+	circuit.trackMemory(options.memory);
+
+	TraceSpan span("read");
+	auto start = std::chrono::steady_clock::now();
+	CircuitBase::Outcome outcome;
+	long long line = 0;
+	if (endsWith(input, ".ncb"))
+		outcome = CircuitBinary::tryLoad(circuit, input);
+	else
+	{
+		NetlistParser parser(circuit);
+		outcome = input == "-" ? parser.tryParse(std::cin) : parser.tryParseFile(input);
+		line = outcome ? 0 : parser.getLine();
+	}
+	stats.readNanoseconds += nanosecondsSince(start);
+
+	if (outcome)
+	{
+		span.next("solve");
+		start = std::chrono::steady_clock::now();
+		if (options.series)
+			outcome = circuit.trySolve();
+		else
+			outcome = cache != nullptr ? cache->trySolve(circuit) : circuit.trySolveNodal();
+		stats.solveNanoseconds += nanosecondsSince(start);
+	}
+
+	if (!outcome)
+	{
+		++stats.failed;
+		reportFailure(input, outcome, line, errorMutex);
+		return;
+	}
+
+	++stats.solved;
+	stats.elements += circuit.getResults().size();
+	if (options.memory)
+	{
+		size_t peak = circuit.getMemoryStats().peak;
+		size_t largest = stats.peakBytes;
+		while (peak > largest && !stats.peakBytes.compare_exchange_weak(largest, peak)) { }
+	}
+	if (writer != nullptr)
+	{
+		span.next("write");
+		std::lock_guard<std::mutex> lock(writerMutex);
+		writer->write(circuit, index);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BatchOptions options;
+	if (!readOptions(argc, argv, options))
+		return 2;
+
+	std::ofstream file;
+	if (!options.output.empty())
+	{
+		file.open(options.output, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Cannot open " << options.output << "\n";
+			return 2;
+		}
+	}
+	std::ostream& output = options.output.empty() ? std::cout : file;
+	std::ios::sync_with_stdio(false);
+
+	// Workers take turns formatting their results, the writer's thread does the writing
+	ResultsWriter* writer = nullptr;
+	if (!options.quiet)
+		writer = new ResultsWriter(output, options.binary ? ResultsWriter::BINARY : ResultsWriter::CSV, true);
+
+	// Shared by the workers, it has its own lock
+	CircuitCache* cache = nullptr;
+	if (options.cacheMegabytes > 0 && !options.series)
+		cache = new CircuitCache((size_t)options.cacheMegabytes << 20);
+	if (cache != nullptr && options.memory)
+		std::cerr << "memory: the cache solves copies of the circuits, their nodal equations aren't measured\n";
+
+	if (!options.trace.empty())
+		CircuitTrace::start();
+
+	BatchStats stats;
+	std::mutex writerMutex, errorMutex;
+	std::atomic<int> next{ 0 };
+	int count = (int)options.inputs.size();
+
+	auto start = std::chrono::steady_clock::now();
+	auto work = [&]()
+	{
+		for (int index = next++; index < count; index = next++)
+			solveInput(options, index, cache, writer, writerMutex, errorMutex, stats);
+	};
+
+	std::vector<std::thread> workers;
+	int threads = std::min(options.threads, count);
+	for (int i = 1; i < threads; ++i)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	bool written = true;
+	if (writer != nullptr)
+	{
+		writer->finish();
+		written = writer->good();
+		delete writer;
+	}
+
+	double seconds = nanosecondsSince(start) / 1e9;
+	std::cerr << stats.solved << " solved, " << stats.failed << " failed, " << threads << " threads, " << seconds << " s\n";
+	std::cerr << stats.solved / seconds << " circuits/s, " << stats.elements / seconds << " elements/s\n";
+	std::cerr << "reading " << stats.readNanoseconds / 1e9 << " s, solving " << stats.solveNanoseconds / 1e9 << " s (summed over threads)\n";
+	if (options.memory)
+		std::cerr << "memory: largest circuit peaked at " << stats.peakBytes / 1e6 << " MB\n";
+	if (cache != nullptr)
+	{
+		CircuitCache::Stats cached = cache->getStats();
+		std::cerr << "cache: " << cached.resultHits << " solved before, " << cached.topologyHits << " topologies seen before, " << cached.misses << " new, " << cached.bytes / 1e6 << " MB\n";
+		delete cache;
+	}
+
+	if (!options.trace.empty())
+	{
+		CircuitTrace::stop();
+		if (CircuitTrace::getDropped() > 0)
+			std::cerr << "trace: " << CircuitTrace::getDropped() << " spans dropped\n";
+		if (!CircuitTrace::save(options.trace))
+			std::cerr << "Cannot write " << options.trace << "\n";
+	}
+
+	if (!written)
+	{
+		std::cerr << "Writing the results failed\n";
+		return 2;
+	}
+	return stats.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "CircuitCore.h"
+
+/*
+	Times solve() on generated circuits of growing size and writes the results as JSON,
+	so runs can be compared over time:
+
+		CircuitBenchmark [options]
+
+		-o path             where the JSON goes (standard output by default)
+		--max-elements n    largest size, sizes go 10, 100, ... up to it (1000000 by default)
+		--budget seconds    a size is only solved if solving the size before took under a thousandth of it (10 by default)
+		--only generator    just one of series, parallel, ladder, tree, grid, wires
+
+	Adding the elements, validate, wire removal, reduction (merges and star-mesh transforms) and unmerge
+	are timed separately, and the counters of CircuitCore::getSolveStats are written next to them.
+	Small sizes are built and solved again until it took a while, and the best run of each part is kept.
+	Progress goes to standard error. Build it without the GUI, with the solve stats compiled in:
+
+		g++ -O2 -DMF_SOLVE_STATS -o CircuitBenchmark CircuitBenchmark.cpp CircuitCore.cpp CircuitNodal.cpp CircuitOrdering.cpp Subcircuit.cpp CircuitCodeGen.cpp CircuitTrace.cpp -std=c++17
+*/
+
+struct BenchmarkOptions
+{
+	std::string output;
+	long long maxElements = 1000000;
+	double budget = 10.0;
+	std::string only;
+};
+
+// Builds a circuit of about size elements, always the same one for the same size
+typedef std::function<void(CircuitCore& circuit, int size)> Generator;
+
+struct BenchmarkCase
+{
+	std::string generator;
+	int size = 0;
+	int elements = 0;
+	int runs = 0;
+	bool solved = false;
+	CircuitBase::Outcome outcome;
+	double add = 0.0;
+	CircuitBase::SolveStats stats;
+	double solve = 0.0;
+};
+
+static std::string nodeName(int index)
+{
+	return "n" + std::to_string(index);
+}
+
+// A battery and resistors in one loop
+static void seriesChain(CircuitCore& circuit, int size)
+{
+	circuit.addBattery("V", 10, nodeName(0), nodeName(size - 1));
+	for (int i = 1; i < size; ++i)
+		circuit.addResistor("R" + std::to_string(i), 100 + i % 7, nodeName(i - 1), nodeName(i));
+}
+
+// Resistors side by side, fed by a battery through one of them
+static void parallelBank(CircuitCore& circuit, int size)
+{
+	circuit.addBattery("V", 10, "ground", "supply");
+	circuit.addResistor("Rs", 1, "supply", "top");
+	for (int i = 2; i < size; ++i)
+		circuit.addResistor("R" + std::to_string(i), 1000 + i % 13, "top", "ground");
+}
+
+// Series resistors with a resistor to ground after each one
+static void ladderNetwork(CircuitCore& circuit, int size)
+{
+	circuit.addBattery("V", 10, "ground", nodeName(0));
+	int rungs = std::max(1, (size - 1) / 2);
+	for (int i = 0; i < rungs; ++i)
+	{
+		circuit.addResistor("Rs" + std::to_string(i), 100 + i % 5, nodeName(i), nodeName(i + 1));
+		circuit.addResistor("Rp" + std::to_string(i), 1000 + i % 11, nodeName(i + 1), "ground");
+	}
+}
+
+// Splits a branch between from and to into a series or parallel pair until it has its share of resistors
+static void seriesParallelBranch(CircuitCore& circuit, int resistors, const std::string& from, const std::string& to, std::mt19937& random, int& nodes, int& names)
+{
+	if (resistors == 1)
+	{
+		circuit.addResistor("R" + std::to_string(names++), 10 + random() % 1000, from, to);
+		return;
+	}
+
+	int first = 1 + (int)(random() % (resistors - 1));
+	if (random() % 2 == 0)
+	{
+		std::string middle = nodeName(nodes++);
+		seriesParallelBranch(circuit, first, from, middle, random, nodes, names);
+		seriesParallelBranch(circuit, resistors - first, middle, to, random, nodes, names);
+	}
+	else
+	{
+		seriesParallelBranch(circuit, first, from, to, random, nodes, names);
+		seriesParallelBranch(circuit, resistors - first, from, to, random, nodes, names);
+	}
+}
+
+// A random series/parallel tree of resistors across a battery
+static void seriesParallelTree(CircuitCore& circuit, int size)
+{
+	std::mt19937 random(size);
+	int nodes = 2;
+	int names = 0;
+	circuit.addBattery("V", 10, nodeName(0), nodeName(1));
+	seriesParallelBranch(circuit, std::max(1, size - 1), nodeName(1), nodeName(0), random, nodes, names);
+}
+
+// A square mesh of resistors with a battery from one corner to the other, only star-mesh transforms reduce it
+static void gridMesh(CircuitCore& circuit, int size)
+{
+	int side = 2;
+	while (2 * (side + 1) * side <= size)
+		++side;
+
+	auto at = [](int row, int column) { return nodeName(row) + "_" + std::to_string(column); };
+	circuit.addBattery("V", 10, at(side - 1, side - 1), at(0, 0));
+	for (int row = 0; row < side; ++row)
+	{
+		for (int column = 0; column < side; ++column)
+		{
+			std::string name = std::to_string(row) + "_" + std::to_string(column);
+			if (column + 1 < side)
+				circuit.addResistor("H" + name, 100 + (row + column) % 3, at(row, column), at(row, column + 1));
+			if (row + 1 < side)
+				circuit.addResistor("V" + name, 100 + (row * column) % 5, at(row, column), at(row + 1, column));
+		}
+	}
+}
+
+// Like circuits drawn in the GUI: a loop of resistors where each connection is a run of wires between dots
+static void mostlyWires(CircuitCore& circuit, int size)
+{
+	const int wiresPerLink = 4;
+	int resistors = std::max(1, size / (wiresPerLink + 1));
+	int dots = 0;
+
+	std::string first = nodeName(dots++);
+	std::string last = first;
+	for (int i = 0; i <= resistors; ++i)
+	{
+		for (int j = 0; j < wiresPerLink; ++j)
+		{
+			std::string dot = nodeName(dots++);
+			circuit.addWire("W" + std::to_string(i) + "_" + std::to_string(j), last, dot);
+			last = dot;
+		}
+
+		std::string dot = nodeName(dots++);
+		if (i == 0)
+			circuit.addBattery("V", 10, dot, last);
+		else
+			circuit.addResistor("R" + std::to_string(i), 100 + i % 9, last, dot);
+		last = dot;
+	}
+	circuit.addWire("Wclose", last, first);
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void keepBest(double& best, double seconds, bool first)
+{
+	if (first || seconds < best)
+		best = seconds;
+}
+
+// Builds and solves until it took a while (or once, for big circuits), keeping the best time of each part
+static BenchmarkCase runCase(const std::string& name, const Generator& generator, int size, bool solve)
+{
+	BenchmarkCase result;
+	result.generator = name;
+	result.size = size;
+	result.solved = solve;
+
+	auto start = std::chrono::steady_clock::now();
+	do
+	{
+		bool first = result.runs == 0;
+		CircuitCore circuit;
+		auto added = std::chrono::steady_clock::now();
+		generator(circuit, size);
+		keepBest(result.add, secondsSince(added), first);
+		if (first)
+			result.elements = circuit.getElementsList().getSize();
+
+		if (solve)
+		{
+			auto solving = std::chrono::steady_clock::now();
+			result.outcome = circuit.trySolve();
+			keepBest(result.solve, secondsSince(solving), first);
+
+			const CircuitBase::SolveStats& stats = circuit.getSolveStats();
+			keepBest(result.stats.validate, stats.validate, first);
+			keepBest(result.stats.wireRemoval, stats.wireRemoval, first);
+			keepBest(result.stats.reduction, stats.reduction, first);
+			keepBest(result.stats.unmerge, stats.unmerge, first);
+
+			// The counters are the same every run
+			result.stats.wiresRemoved = stats.wiresRemoved;
+			result.stats.connections = stats.connections;
+			result.stats.seriesMerges = stats.seriesMerges;
+			result.stats.parallelMerges = stats.parallelMerges;
+			result.stats.starToMesh = stats.starToMesh;
+			result.stats.meshToStar = stats.meshToStar;
+			result.stats.unmergeDepth = stats.unmergeDepth;
+			result.stats.allocations = stats.allocations;
+			result.stats.listRemovals = stats.listRemovals;
+		}
+		++result.runs;
+	} while (secondsSince(start) < 0.2 && size <= 100000);
+
+	return result;
+}
+
+static void writeJson(std::ostream& output, const std::vector<BenchmarkCase>& cases)
+{
+	// Without the stats every phase and counter is 0, only add and solve mean something
+#ifdef MF_SOLVE_STATS
+	bool solveStats = true;
+#else
+	bool solveStats = false;
+#endif
+	output << "{\n\t\"benchmark\": \"CircuitBenchmark\",\n\t\"version\": 2,\n\t\"unit\": \"seconds, best run\",";
+	output << "\n\t\"solveStats\": " << (solveStats ? "true" : "false") << ",\n\t\"cases\": [";
+	for (size_t i = 0; i < cases.size(); ++i)
+	{
+		const BenchmarkCase& item = cases[i];
+		output << (i == 0 ? "\n" : ",\n");
+		output << "\t\t{ \"generator\": \"" << item.generator << "\", \"size\": " << item.size << ", \"elements\": " << item.elements;
+		output << ", \"runs\": " << item.runs << ", \"add\": " << item.add;
+		if (!item.solved)
+		{
+			output << ", \"solved\": false }";
+			continue;
+		}
+
+		output << ", \"solved\": true, \"ok\": " << (item.outcome ? "true" : "false");
+		if (!item.outcome)
+			output << ", \"error\": " << item.outcome.error;
+		output << ", \"validate\": " << item.stats.validate << ", \"wireRemoval\": " << item.stats.wireRemoval;
+		output << ", \"reduction\": " << item.stats.reduction << ", \"unmerge\": " << item.stats.unmerge;
+		output << ", \"wiresRemoved\": " << item.stats.wiresRemoved << ", \"connections\": " << item.stats.connections;
+		output << ", \"seriesMerges\": " << item.stats.seriesMerges << ", \"parallelMerges\": " << item.stats.parallelMerges;
+		output << ", \"starToMesh\": " << item.stats.starToMesh << ", \"meshToStar\": " << item.stats.meshToStar;
+		output << ", \"unmergeDepth\": " << item.stats.unmergeDepth << ", \"allocations\": " << item.stats.allocations;
+		output << ", \"listRemovals\": " << item.stats.listRemovals;
+		output << ", \"solve\": " << item.solve << " }";
+	}
+	output << "\n\t]\n}\n";
+}
+
+static bool readOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Unknown option " << argument << "\n";
+			return false;
+		}
+
+		if (argument == "-o")
+			options.output = argv[++i];
+		else if (argument == "--max-elements")
+			options.maxElements = std::atoll(argv[++i]);
+		else if (argument == "--budget")
+			options.budget = std::atof(argv[++i]);
+		else if (argument == "--only")
+			options.only = argv[++i];
+		else
+		{
+			std::cerr << "Unknown option " << argument << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	if (!readOptions(argc, argv, options))
+		return 2;
+
+	std::vector<std::pair<std::string, Generator>> generators = {
+		{ "series", seriesChain },
+		{ "parallel", parallelBank },
+		{ "ladder", ladderNetwork },
+		{ "tree", seriesParallelTree },
+		{ "grid", gridMesh },
+		{ "wires", mostlyWires },
+	};
+
+	std::vector<BenchmarkCase> cases;
+	for (auto& generator : generators)
+	{
+		if (!options.only.empty() && options.only != generator.first)
+			continue;
+
+		// Reduction is quadratic or worse, so sizes past the budget are only built
+		bool solve = true;
+		for (long long size = 10; size <= options.maxElements; size *= 10)
+		{
+			BenchmarkCase result = runCase(generator.first, generator.second, (int)size, solve);
+			std::cerr << generator.first << " " << result.elements << " elements: add " << result.add << " s";
+			if (solve)
+				std::cerr << ", solve " << result.solve << " s" << (result.outcome ? "" : " (failed with error " + std::to_string(result.outcome.error) + ")");
+			std::cerr << std::endl;
+
+			solve = solve && result.solve * 1000 < options.budget;
+			cases.push_back(result);
+		}
+	}
+
+	std::ofstream file;
+	if (!options.output.empty())
+	{
+		file.open(options.output);
+		if (!file)
+		{
+			std::cerr << "Cannot open " << options.output << "\n";
+			return 2;
+		}
+	}
+	writeJson(options.output.empty() ? std::cout : file, cases);
+	return 0;
+}
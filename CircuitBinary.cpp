@@ -0,0 +1,357 @@
+#include "CircuitBinary.h"
+#include "CircuitNodal.h"
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bytes of a section, from the start of the file
+struct BinarySection
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct BinaryHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t scalarType;
+	uint32_t scalarSize;
+	uint64_t nodeCount;
+	uint64_t elementCount;
+	BinarySection nodeNameStarts;
+	BinarySection nodeNames;
+	BinarySection elementNameStarts;
+	BinarySection elementNames;
+	BinarySection kinds;
+	BinarySection links;
+	BinarySection voltages;
+	BinarySection resistances;
+	BinarySection ordering;
+};
+
+enum BinaryKind
+{
+	BINARY_WIRE,
+	BINARY_RESISTOR,
+	BINARY_BATTERY,
+	// Battery with a resistance, like the ones port models add
+	BINARY_SOURCE,
+};
+
+// \r\n catches files that went through a text conversion
+static const char binaryMagic[8] = { 'N', 'C', 'S', 'B', 'I', 'N', '\r', '\n' };
+static const uint32_t binaryByteOrder = 0x01020304;
+// Sections start at multiples of this, so arrays of any scalar can be read in place
+static const uint64_t binaryAlignment = 16;
+
+// Appends a section to the image and tells where it went
+static BinarySection appendSection(std::string& image, const void* data, uint64_t size)
+{
+	uint64_t aligned = (image.size() + binaryAlignment - 1) / binaryAlignment * binaryAlignment;
+	image.resize(aligned, '\0');
+	image.append((const char*)data, size);
+
+	return BinarySection{ aligned, size };
+}
+
+static bool validSection(const BinarySection& section, uint64_t fileSize, uint64_t expectedSize)
+{
+	return section.offset % binaryAlignment == 0 && section.offset <= fileSize
+		&& section.size <= fileSize - section.offset && section.size == expectedSize;
+}
+
+// Offsets of count names into their text, increasing and ending at the end of the text
+static bool validNames(const uint64_t* starts, uint64_t count, uint64_t textSize)
+{
+	if (starts[0] != 0 || starts[count] != textSize)
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+		if (starts[i] > starts[i + 1])
+			return false;
+	return true;
+}
+
+/*
+================= Public realization of class BasicCircuitBinary =================
+*/
+
+template <typename Scalar>
+void BasicCircuitBinary<Scalar>::save(const CircuitCore& circuit, const std::string& path, const Ordering* ordering)
+{
+	Outcome outcome = trySave(circuit, path, ordering);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+void BasicCircuitBinary<Scalar>::load(CircuitCore& circuit, const std::string& path, std::vector<int>* ordering)
+{
+	Outcome outcome = tryLoad(circuit, path, ordering);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+std::string BasicCircuitBinary<Scalar>::saveImage(const CircuitCore& circuit, const Ordering* ordering)
+{
+	std::string image;
+	Outcome outcome = trySaveImage(circuit, image, ordering);
+	if (!outcome)
+		throw outcome.error;
+
+	return image;
+}
+
+template <typename Scalar>
+void BasicCircuitBinary<Scalar>::loadImage(CircuitCore& circuit, const char* data, size_t size, std::vector<int>* ordering)
+{
+	Outcome outcome = tryLoadImage(circuit, data, size, ordering);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitBinary<Scalar>::trySave(const CircuitCore& circuit, const std::string& path, const Ordering* ordering)
+{
+	std::string image;
+	Outcome outcome = trySaveImage(circuit, image, ordering);
+	if (!outcome)
+		return outcome;
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	output.write(image.data(), (std::streamsize)image.size());
+	output.close();
+	if (!output)
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+
+	return Outcome();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitBinary<Scalar>::trySaveImage(const CircuitCore& circuit, std::string& image, const Ordering* ordering)
+{
+	// A solved circuit holds the merged elements instead of the ones that were added
+	if (circuit.dirty())
+		return Outcome::failure(CircuitBase::DIRTY_CIRCUIT);
+
+	std::vector<int32_t> order;
+	if (ordering != nullptr)
+	{
+		BasicNodalSystem<Scalar> system(circuit);
+		if (!system.getOutcome())
+			return system.getOutcome();
+		std::vector<int> computed = system.order(*ordering);
+		order.assign(computed.begin(), computed.end());
+	}
+
+	// Nodes in the order the circuit keeps them, so the nodal equations come out the same when loaded
+	std::unordered_map<const Node*, uint32_t> indices;
+	std::vector<uint64_t> nodeNameStarts(1, 0);
+	std::string nodeNames;
+	for (const Node* node : circuit._nodes)
+	{
+		indices[node] = (uint32_t)indices.size();
+		nodeNames += node->_name;
+		nodeNameStarts.push_back(nodeNames.size());
+	}
+
+	std::vector<uint64_t> elementNameStarts(1, 0);
+	std::string elementNames;
+	std::vector<uint8_t> kinds;
+	std::vector<uint32_t> links;
+	std::vector<Scalar> voltages;
+	std::vector<Scalar> resistances;
+	for (const Element* element : circuit._added)
+	{
+		if (element == nullptr)
+			continue;
+
+		// Same thresholds as isBattery and isWire of the circuit
+		bool battery = ScalarTraits<Scalar>::magnitude(element->_voltage) > ScalarTraits<Scalar>::zero();
+		bool resistive = ScalarTraits<Scalar>::magnitude(element->_resistance) >= ScalarTraits<Scalar>::zero();
+		uint8_t kind = battery ? (resistive ? BINARY_SOURCE : BINARY_BATTERY) : (resistive ? BINARY_RESISTOR : BINARY_WIRE);
+
+		elementNames += element->_name;
+		elementNameStarts.push_back(elementNames.size());
+		kinds.push_back(kind);
+		links.push_back(indices.at(element->_node1));
+		links.push_back(indices.at(element->_node2));
+		voltages.push_back(element->_voltage);
+		resistances.push_back(element->_resistance);
+	}
+
+	BinaryHeader header = {};
+	std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version = version;
+	header.byteOrder = binaryByteOrder;
+	header.scalarType = ScalarTraits<Scalar>::fileType();
+	header.scalarSize = sizeof(Scalar);
+	header.nodeCount = indices.size();
+	header.elementCount = kinds.size();
+
+	// The header goes first once we know where everything is
+	image.assign(sizeof(header), '\0');
+	header.nodeNameStarts = appendSection(image, nodeNameStarts.data(), nodeNameStarts.size() * sizeof(uint64_t));
+	header.nodeNames = appendSection(image, nodeNames.data(), nodeNames.size());
+	header.elementNameStarts = appendSection(image, elementNameStarts.data(), elementNameStarts.size() * sizeof(uint64_t));
+	header.elementNames = appendSection(image, elementNames.data(), elementNames.size());
+	header.kinds = appendSection(image, kinds.data(), kinds.size());
+	header.links = appendSection(image, links.data(), links.size() * sizeof(uint32_t));
+	header.voltages = appendSection(image, voltages.data(), voltages.size() * sizeof(Scalar));
+	header.resistances = appendSection(image, resistances.data(), resistances.size() * sizeof(Scalar));
+	header.ordering = appendSection(image, order.data(), order.size() * sizeof(int32_t));
+	std::memcpy(&image[0], &header, sizeof(header));
+
+	return Outcome();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitBinary<Scalar>::tryLoad(CircuitCore& circuit, const std::string& path, std::vector<int>* ordering)
+{
+	if (circuit.dirty())
+		return Outcome::failure(CircuitBase::DIRTY_CIRCUIT);
+
+#ifndef _WIN32
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+
+	struct stat info;
+	if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		size_t size = (size_t)info.st_size;
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapped != MAP_FAILED)
+		{
+			close(file);
+			Outcome outcome = tryLoadImage(circuit, (const char*)mapped, size, ordering);
+			munmap(mapped, size);
+			return outcome;
+		}
+	}
+	close(file);
+#endif
+
+	// Systems without mmap read the whole file, new[] aligns it for any scalar
+	std::ifstream input(path, std::ios::binary | std::ios::ate);
+	if (!input)
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+
+	size_t size = (size_t)input.tellg();
+	std::unique_ptr<char[]> data(new char[size > 0 ? size : 1]);
+	input.seekg(0);
+	if (!input.read(data.get(), (std::streamsize)size))
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+
+	return tryLoadImage(circuit, data.get(), size, ordering);
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitBinary<Scalar>::tryLoadImage(CircuitCore& circuit, const char* data, size_t size, std::vector<int>* ordering)
+{
+	if (circuit.dirty())
+		return Outcome::failure(CircuitBase::DIRTY_CIRCUIT);
+
+	Outcome invalid = Outcome::failure(CircuitBase::BINARY_INVALID);
+
+	BinaryHeader header;
+	if (size < sizeof(header))
+		return invalid;
+	std::memcpy(&header, data, sizeof(header));
+
+	if (std::memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0 || header.version != version || header.byteOrder != binaryByteOrder)
+		return invalid;
+	if (header.scalarType != ScalarTraits<Scalar>::fileType() || header.scalarSize != sizeof(Scalar))
+		return invalid;
+
+	// Every size is checked against the file before anything is read from it
+	uint64_t nodeCount = header.nodeCount;
+	uint64_t elementCount = header.elementCount;
+	if (nodeCount > size / sizeof(uint64_t) || elementCount > size / (2 * sizeof(uint32_t)) || elementCount > INT_MAX || nodeCount > UINT32_MAX)
+		return invalid;
+
+	if (!validSection(header.nodeNameStarts, size, (nodeCount + 1) * sizeof(uint64_t))
+		|| !validSection(header.nodeNames, size, header.nodeNames.size)
+		|| !validSection(header.elementNameStarts, size, (elementCount + 1) * sizeof(uint64_t))
+		|| !validSection(header.elementNames, size, header.elementNames.size)
+		|| !validSection(header.kinds, size, elementCount)
+		|| !validSection(header.links, size, elementCount * 2 * sizeof(uint32_t))
+		|| !validSection(header.voltages, size, elementCount * sizeof(Scalar))
+		|| !validSection(header.resistances, size, elementCount * sizeof(Scalar))
+		|| !validSection(header.ordering, size, header.ordering.size) || header.ordering.size % sizeof(int32_t) != 0)
+		return invalid;
+
+	const uint64_t* nodeNameStarts = (const uint64_t*)(data + header.nodeNameStarts.offset);
+	const char* nodeNames = data + header.nodeNames.offset;
+	const uint64_t* elementNameStarts = (const uint64_t*)(data + header.elementNameStarts.offset);
+	const char* elementNames = data + header.elementNames.offset;
+	const uint8_t* kinds = (const uint8_t*)(data + header.kinds.offset);
+	const uint32_t* links = (const uint32_t*)(data + header.links.offset);
+	const Scalar* voltages = (const Scalar*)(data + header.voltages.offset);
+	const Scalar* resistances = (const Scalar*)(data + header.resistances.offset);
+	const int32_t* order = (const int32_t*)(data + header.ordering.offset);
+
+	if (!validNames(nodeNameStarts, nodeCount, header.nodeNames.size) || !validNames(elementNameStarts, elementCount, header.elementNames.size))
+		return invalid;
+	for (uint64_t i = 0; i < elementCount; ++i)
+		if (kinds[i] > BINARY_SOURCE || links[2 * i] >= nodeCount || links[2 * i + 1] >= nodeCount)
+			return invalid;
+
+	// Whatever can fail is checked here, so a failed load leaves the circuit as it was
+	auto nodeName = [&](uint64_t i) { return std::string_view(nodeNames + nodeNameStarts[i], nodeNameStarts[i + 1] - nodeNameStarts[i]); };
+	auto elementName = [&](uint64_t i) { return std::string_view(elementNames + elementNameStarts[i], elementNameStarts[i + 1] - elementNameStarts[i]); };
+	std::unordered_set<std::string_view> names;
+	names.reserve(elementCount);
+	for (uint64_t i = 0; i < elementCount; ++i)
+	{
+		std::string_view name = elementName(i);
+		if (!names.insert(name).second || (!circuit._elementsByName.empty() && circuit._elementsByName.count(std::string(name)) != 0))
+			return Outcome::failure(CircuitBase::ELEMENT_ALREADY_EXIST, std::string(name));
+		if (nodeName(links[2 * i]) == nodeName(links[2 * i + 1]))
+			return Outcome::failure(CircuitBase::TWO_SAME_NODES, std::string(name), std::string(nodeName(links[2 * i])));
+	}
+
+	circuit.reserve((int)(circuit._added.size() + elementCount), (int)(circuit._nodes.getSize() + nodeCount));
+
+	std::vector<Node*> nodes(nodeCount);
+	for (uint64_t i = 0; i < nodeCount; ++i)
+		nodes[i] = circuit.searchOrCreateNode(std::string(nodeName(i)));
+
+	// One allocation for all the elements, the circuit frees it
+	Element* block = elementCount > 0 ? circuit.allocateElements((int)elementCount) : nullptr;
+	for (uint64_t i = 0; i < elementCount; ++i)
+	{
+		Element* element = &block[i];
+		element->_name.assign(elementNames + elementNameStarts[i], elementNameStarts[i + 1] - elementNameStarts[i]);
+		element->_voltage = voltages[i];
+		element->_resistance = resistances[i];
+		element->_node1 = nodes[links[2 * i]];
+		element->_node2 = nodes[links[2 * i + 1]];
+		// Can't fail, the names were checked above
+		circuit.tryAttach(element);
+	}
+
+	if (ordering != nullptr)
+		ordering->assign(order, order + header.ordering.size / sizeof(int32_t));
+
+	return Outcome();
+}
+
+template class BasicCircuitBinary<float>;
+template class BasicCircuitBinary<double>;
+template class BasicCircuitBinary<long double>;
+template class BasicCircuitBinary<std::complex<double>>;
@@ -0,0 +1,51 @@
+#ifndef MF_CIRCUIT_BINARY_DEF
+#define MF_CIRCUIT_BINARY_DEF
+
+#include <string>
+#include <vector>
+#include "CircuitCore.h"
+#include "CircuitOrdering.h"
+
+/*
+	A circuit saved as packed arrays, so loading it is reading memory instead of parsing text:
+
+		header      magic, version, byte order, scalar type, counts and where each section starts
+		node names  count + 1 offsets into the text of all names, then the text
+		elements    names the same way, one kind byte each, node indices (negative, positive),
+		            voltages and resistances as Scalar
+		ordering    optional elimination order of the nodal equations
+
+	load maps the file into memory (where it can), creates every node once and builds all the
+	elements in a single block owned by the circuit. Elements keep the order they were added in,
+	so results and a saved ordering line up with the original circuit.
+	Files only load in the same scalar type (and byte order) they were saved in.
+*/
+template <typename Scalar>
+class BasicCircuitBinary
+{
+	typedef BasicCircuitCore<Scalar> CircuitCore;
+	typedef BasicNode<Scalar> Node;
+	typedef BasicElement<Scalar> Element;
+	typedef CircuitBase::Outcome Outcome;
+
+public:
+	static const unsigned version = 1;
+
+	// With an ordering, the order it gives this circuit is saved too
+	static void save(const CircuitCore& circuit, const std::string& path, const Ordering* ordering = nullptr);
+	// Adds the saved elements to circuit, ordering (if given) gets the saved order or stays empty
+	static void load(CircuitCore& circuit, const std::string& path, std::vector<int>* ordering = nullptr);
+
+	static Outcome trySave(const CircuitCore& circuit, const std::string& path, const Ordering* ordering = nullptr);
+	static Outcome tryLoad(CircuitCore& circuit, const std::string& path, std::vector<int>* ordering = nullptr);
+
+	// The same in memory (aligned to 16 bytes), like for keeping a clean copy of a circuit to solve again later
+	static std::string saveImage(const CircuitCore& circuit, const Ordering* ordering = nullptr);
+	static void loadImage(CircuitCore& circuit, const char* data, size_t size, std::vector<int>* ordering = nullptr);
+	static Outcome trySaveImage(const CircuitCore& circuit, std::string& image, const Ordering* ordering = nullptr);
+	static Outcome tryLoadImage(CircuitCore& circuit, const char* data, size_t size, std::vector<int>* ordering = nullptr);
+};
+
+typedef BasicCircuitBinary<double> CircuitBinary;
+
+#endif // MF_CIRCUIT_BINARY_DEF
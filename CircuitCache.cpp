@@ -0,0 +1,417 @@
+#include "CircuitCache.h"
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <string>
+#include <tuple>
+
+enum CacheKind
+{
+	CACHE_WIRE,
+	CACHE_RESISTOR,
+	CACHE_BATTERY,
+	// Battery with a resistance, like the ones port models add
+	CACHE_SOURCE,
+};
+
+// Rounds of refining node colors, nodes further apart than this are told apart by the order of the circuit
+static const int cacheRounds = 8;
+
+// Bytes an entry costs besides its arrays (list and hash table nodes)
+static const size_t cacheOverhead = 128;
+
+static uint64_t mixHash(uint64_t seed, uint64_t value)
+{
+	// splitmix64 finalizer of both
+	uint64_t mixed = value + seed * 0x9E3779B97F4A7C15ULL + 0x632BE59BD9B4E019ULL;
+	mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+	return mixed ^ (mixed >> 31);
+}
+
+template <typename Real>
+static uint64_t mixValue(uint64_t seed, Real value)
+{
+	return mixHash(seed, std::hash<Real>()(value));
+}
+
+template <typename Real>
+static uint64_t mixValue(uint64_t seed, const std::complex<Real>& value)
+{
+	return mixValue(mixValue(seed, value.real()), value.imag());
+}
+
+// Names in the copy are the numbers of its elements and nodes
+static bool copyNumber(const std::string& name, size_t count, size_t& number)
+{
+	std::from_chars_result parsed = std::from_chars(name.data(), name.data() + name.size(), number);
+	return !name.empty() && parsed.ec == std::errc() && parsed.ptr == name.data() + name.size() && number < count;
+}
+
+// Orders like the ordering it wraps and keeps the order, so a new topology is ordered by the solve itself
+class RecordingOrdering : public Ordering
+{
+public:
+	RecordingOrdering(const Ordering& ordering, std::vector<int>& order) : _ordering(ordering), _order(order) { }
+
+	std::string getName() const override { return _ordering.getName(); }
+	// The wrapped ordering does the caching, this one has to see every call
+	bool cacheable() const override { return false; }
+
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override
+	{
+		_order = _ordering.cachedOrder(graph);
+		return _order;
+	}
+
+private:
+	const Ordering& _ordering;
+	std::vector<int>& _order;
+};
+
+/*
+================= Public realization of class BasicCircuitCache =================
+*/
+
+template <typename Scalar>
+BasicCircuitCache<Scalar>::BasicCircuitCache(size_t capacity, const Ordering* ordering) : _capacity(capacity), _ordering(ordering) { }
+
+template <typename Scalar>
+void BasicCircuitCache<Scalar>::solve(CircuitCore& circuit, Precision precision)
+{
+	Outcome status = trySolve(circuit, precision);
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCache<Scalar>::trySolve(CircuitCore& circuit, Precision precision)
+{
+	if (circuit.dirty())
+		return Outcome::failure(CircuitBase::DIRTY_CIRCUIT);
+
+	Canonical canonical;
+	canonicalize(circuit, canonical);
+
+	Entry entry;
+	bool solved = false;
+	bool known = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const Entry* found = find(canonical.values, true, canonical);
+		solved = found != nullptr;
+		if (solved)
+		{
+			++_stats.resultHits;
+			entry.solved = found->solved;
+			entry.outcome = found->outcome;
+			entry.dirty = found->dirty;
+		}
+		else if ((found = find(canonical.topology, false, canonical)) != nullptr)
+		{
+			++_stats.topologyHits;
+			known = true;
+			entry.order = found->order;
+		}
+		else
+			++_stats.misses;
+	}
+
+	if (solved)
+	{
+		Outcome outcome;
+		apply(circuit, canonical, entry, outcome);
+		return outcome;
+	}
+
+	// The copy adds elements in the order of the structure, so equal structures get equal matrices
+	CircuitCore copy;
+	copy.reserve((int)canonical.links.size(), (int)canonical.nodes.size());
+	for (int i = 0; i < (int)canonical.links.size(); ++i)
+	{
+		const Link& link = canonical.links[i];
+		Element* added = nullptr;
+		copy.tryAddElement(std::to_string(i), canonical.voltages[i], Scalar(0), canonical.resistances[i], std::to_string(link.node1), std::to_string(link.node2), &added);
+		copy.track(added);
+	}
+
+	// A known topology solves with its stored order, a new one keeps the order its solve used
+	AutoOrdering automatic;
+	const Ordering& ordering = _ordering != nullptr ? *_ordering : automatic;
+	if (known)
+	{
+		StoredOrdering stored(std::move(entry.order), &ordering);
+		entry.outcome = copy.trySolveNodal(&stored, precision);
+	}
+	else
+	{
+		RecordingOrdering recording(ordering, entry.order);
+		entry.outcome = copy.trySolveNodal(&recording, precision);
+	}
+	entry.dirty = copy.dirty();
+	if (entry.outcome)
+	{
+		entry.solved.reserve(3 * canonical.links.size());
+		for (const BasicElementResult<Scalar>& result : copy.getResults())
+		{
+			entry.solved.push_back(result.voltage);
+			entry.solved.push_back(result.current);
+			entry.solved.push_back(result.resistance);
+		}
+	}
+
+	Outcome outcome;
+	apply(circuit, canonical, entry, outcome);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!known && !entry.order.empty())
+	{
+		Entry topology;
+		topology.key = canonical.topology;
+		topology.links = canonical.links;
+		topology.order = std::move(entry.order);
+		insert(std::move(topology));
+	}
+
+	entry.key = canonical.values;
+	entry.results = true;
+	entry.links = std::move(canonical.links);
+	entry.voltages = std::move(canonical.voltages);
+	entry.resistances = std::move(canonical.resistances);
+	entry.order.clear();
+	insert(std::move(entry));
+
+	return outcome;
+}
+
+template <typename Scalar>
+uint64_t BasicCircuitCache<Scalar>::hashTopology(const CircuitCore& circuit)
+{
+	Canonical canonical;
+	canonicalize(circuit, canonical);
+	return canonical.topology;
+}
+
+template <typename Scalar>
+typename BasicCircuitCache<Scalar>::Stats BasicCircuitCache<Scalar>::getStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+template <typename Scalar>
+void BasicCircuitCache<Scalar>::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries.clear();
+	_keys.clear();
+	_stats.entries = 0;
+	_stats.bytes = 0;
+}
+
+/*
+================= Private realization of class BasicCircuitCache =================
+*/
+
+template <typename Scalar>
+void BasicCircuitCache<Scalar>::canonicalize(const CircuitCore& circuit, Canonical& canonical)
+{
+	std::vector<Element*> elements;
+	elements.reserve(circuit._elements.getSize());
+	for (Element* element : circuit._elements)
+		elements.push_back(element);
+	int count = (int)elements.size();
+
+	// Kinds are what the elements were added as (solving makes every element look like a battery),
+	// and shorts use the threshold of the nodal system, so equal kinds mean equal rows
+	std::vector<uint8_t> kinds(count);
+	std::unordered_map<Node*, int> indices;
+	indices.reserve(2 * count);
+	std::vector<Node*> nodes;
+	std::vector<int> ends(2 * count);
+	for (int i = 0; i < count; ++i)
+	{
+		Element* element = elements[i];
+		bool battery = element->_battery;
+		bool resistive = ScalarTraits<Scalar>::magnitude(element->_resistance) > ScalarTraits<Scalar>::shortCircuit();
+		kinds[i] = battery ? (resistive ? CACHE_SOURCE : CACHE_BATTERY) : (resistive ? CACHE_RESISTOR : CACHE_WIRE);
+
+		for (int side = 0; side < 2; ++side)
+		{
+			Node* node = side == 0 ? element->_node1 : element->_node2;
+			auto added = indices.try_emplace(node, (int)nodes.size());
+			if (added.second)
+				nodes.push_back(node);
+			ends[2 * i + side] = added.first->second;
+		}
+	}
+
+	// Ends of the elements at each node, node i owns [starts[i], starts[i + 1])
+	int nodeCount = (int)nodes.size();
+	std::vector<int> starts(nodeCount + 1, 0);
+	for (int end : ends)
+		++starts[end + 1];
+	for (int i = 0; i < nodeCount; ++i)
+		starts[i + 1] += starts[i];
+	std::vector<int> incident(ends.size());
+	std::vector<int> filled(starts.begin(), starts.end() - 1);
+	for (int i = 0; i < (int)ends.size(); ++i)
+		incident[filled[ends[i]]++] = i;
+
+	/*
+		Color refinement: a node's next color mixes its color with the colors of its neighbors,
+		each with the kind and side of the element that leads there (summed, so their order doesn't matter).
+		Names never get in, so circuits that differ only in names end with the same colors
+	*/
+	std::vector<uint64_t> colors(nodeCount), next(nodeCount), distinct;
+	for (int i = 0; i < nodeCount; ++i)
+		colors[i] = starts[i + 1] - starts[i];
+	std::vector<uint64_t> sides(ends.size());
+	for (int end = 0; end < (int)ends.size(); ++end)
+		sides[end] = mixHash(kinds[end / 2], end & 1);
+
+	size_t classes = 0;
+	for (int round = 0; round < cacheRounds; ++round)
+	{
+		for (int i = 0; i < nodeCount; ++i)
+		{
+			uint64_t neighbors = 0;
+			for (int j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				int end = incident[j];
+				neighbors += mixHash(sides[end], colors[ends[end ^ 1]]);
+			}
+			next[i] = mixHash(colors[i], neighbors);
+		}
+		colors.swap(next);
+
+		// Stop once no class split
+		distinct = colors;
+		std::sort(distinct.begin(), distinct.end());
+		size_t split = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+		if (split == classes)
+			break;
+		classes = split;
+	}
+
+	// Elements sorted by kind and colors, ties keep the order of the circuit
+	std::vector<int> sorted(count);
+	for (int i = 0; i < count; ++i)
+		sorted[i] = i;
+	auto key = [&](int i) { return std::make_tuple(kinds[i], colors[ends[2 * i]], colors[ends[2 * i + 1]]); };
+	std::stable_sort(sorted.begin(), sorted.end(), [&](int a, int b) { return key(a) < key(b); });
+
+	canonical.topology = mixHash(count, nodeCount);
+	for (int i : sorted)
+		canonical.topology = mixHash(mixHash(mixHash(canonical.topology, kinds[i]), colors[ends[2 * i]]), colors[ends[2 * i + 1]]);
+
+	// Nodes are numbered as the sorted elements reach them
+	std::vector<int> numbers(nodeCount, -1);
+	canonical.links.reserve(count);
+	canonical.voltages.reserve(count);
+	canonical.resistances.reserve(count);
+	canonical.elements.reserve(count);
+	canonical.nodes.reserve(nodeCount);
+	uint64_t values = canonical.topology;
+	for (int i : sorted)
+	{
+		for (int side = 0; side < 2; ++side)
+		{
+			int node = ends[2 * i + side];
+			if (numbers[node] == -1)
+			{
+				numbers[node] = (int)canonical.nodes.size();
+				canonical.nodes.push_back(nodes[node]);
+			}
+		}
+
+		Element* element = elements[i];
+		canonical.links.push_back(Link{ kinds[i], numbers[ends[2 * i]], numbers[ends[2 * i + 1]] });
+		canonical.voltages.push_back(element->_voltage);
+		canonical.resistances.push_back(element->_resistance);
+		canonical.elements.push_back(element);
+		values = mixValue(mixValue(values, element->_voltage), element->_resistance);
+	}
+	canonical.values = values;
+}
+
+template <typename Scalar>
+void BasicCircuitCache<Scalar>::apply(CircuitCore& circuit, const Canonical& canonical, const Entry& entry, Outcome& outcome)
+{
+	// Errors of the copy name its numbers
+	outcome = entry.outcome;
+	size_t number = 0;
+	if (copyNumber(outcome.element, canonical.elements.size(), number))
+		outcome.element = canonical.elements[number]->getName();
+	if (copyNumber(outcome.node, canonical.nodes.size(), number))
+		outcome.node = canonical.nodes[number]->getName();
+
+	if (!entry.dirty)
+		return;
+
+	circuit.isDirty = true;
+	if (!entry.outcome)
+		return;
+
+	for (int i = 0; i < (int)canonical.elements.size(); ++i)
+	{
+		Element* element = canonical.elements[i];
+		element->_voltage = entry.solved[3 * i];
+		element->_current = entry.solved[3 * i + 1];
+		element->_resistance = entry.solved[3 * i + 2];
+	}
+	circuit.collectResults();
+}
+
+template <typename Scalar>
+const typename BasicCircuitCache<Scalar>::Entry* BasicCircuitCache<Scalar>::find(uint64_t key, bool results, const Canonical& canonical)
+{
+	auto found = _keys.find(key);
+	if (found == _keys.end())
+		return nullptr;
+
+	const Entry& entry = *found->second;
+	if (entry.results != results || !(entry.links == canonical.links))
+		return nullptr;
+	if (results && (!(entry.voltages == canonical.voltages) || !(entry.resistances == canonical.resistances)))
+		return nullptr;
+
+	_entries.splice(_entries.begin(), _entries, found->second);
+	return &_entries.front();
+}
+
+template <typename Scalar>
+void BasicCircuitCache<Scalar>::insert(Entry&& entry)
+{
+	entry.bytes = sizeof(Entry) + cacheOverhead + entry.links.size() * sizeof(Link) + entry.order.size() * sizeof(int)
+		+ (entry.voltages.size() + entry.resistances.size() + entry.solved.size()) * sizeof(Scalar)
+		+ entry.outcome.element.size() + entry.outcome.node.size();
+	if (entry.bytes > _capacity)
+		return;
+
+	// Another thread may have solved the same circuit meanwhile, or a different one collided
+	auto found = _keys.find(entry.key);
+	if (found != _keys.end())
+	{
+		_stats.bytes -= found->second->bytes;
+		_entries.erase(found->second);
+		_keys.erase(found);
+	}
+
+	_stats.bytes += entry.bytes;
+	_entries.push_front(std::move(entry));
+	_keys[_entries.front().key] = _entries.begin();
+
+	while (_stats.bytes > _capacity)
+	{
+		_stats.bytes -= _entries.back().bytes;
+		_keys.erase(_entries.back().key);
+		_entries.pop_back();
+	}
+	_stats.entries = _entries.size();
+}
+
+template class BasicCircuitCache<float>;
+template class BasicCircuitCache<double>;
+template class BasicCircuitCache<long double>;
+template class BasicCircuitCache<std::complex<double>>;
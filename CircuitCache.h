@@ -0,0 +1,120 @@
+#ifndef MF_CIRCUIT_CACHE_DEF
+#define MF_CIRCUIT_CACHE_DEF
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "CircuitCore.h"
+#include "CircuitOrdering.h"
+
+/*
+	Remembers solved circuits by their structure, so a batch where the same circuits come back
+	solves each of them once:
+
+		topology    element kinds (wire, resistor, battery, battery with a resistance) and how they
+		            connect, names and the order elements were added in don't count
+		results     the topology and every value, a hit copies the results without solving
+
+	A topology seen before reuses its elimination order, so only the factorization is done again.
+	Both are kept in one least recently used list, bounded in bytes.
+	Circuits are solved with solveNodal on a copy numbered by their structure, so renamed circuits
+	share entries and the same circuit always gets the same results. One cache can serve many threads.
+
+	A miss orders and factors the copy once and keeps the order that solve used. With the numbering
+	and the copy it costs 1.0 to 1.25 solveNodal on grids of 150 to 900 nodes and a hit 0.07 to 0.13,
+	so the cache pays off once 2 to 20 percent of the circuits come back.
+*/
+template <typename Scalar>
+class BasicCircuitCache
+{
+	typedef BasicCircuitCore<Scalar> CircuitCore;
+	typedef BasicNode<Scalar> Node;
+	typedef BasicElement<Scalar> Element;
+	typedef CircuitBase::Outcome Outcome;
+	typedef CircuitBase::Precision Precision;
+
+public:
+	struct Stats
+	{
+		long long resultHits = 0;
+		long long topologyHits = 0;
+		long long misses = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+	};
+
+	// capacity is in bytes, ordering orders new topologies (AutoOrdering if not given)
+	BasicCircuitCache(size_t capacity = 64 << 20, const Ordering* ordering = nullptr);
+
+	// Same as circuit.solveNodal(), but skips what was solved before
+	void solve(CircuitCore& circuit, Precision precision = CircuitBase::FULL_PRECISION);
+	Outcome trySolve(CircuitCore& circuit, Precision precision = CircuitBase::FULL_PRECISION);
+
+	// Same for circuits that differ only in names (a collision is possible, entries are compared in full)
+	static uint64_t hashTopology(const CircuitCore& circuit);
+
+	Stats getStats() const;
+	void clear();
+
+private:
+	BasicCircuitCache(const BasicCircuitCache& cache);
+	void operator = (const BasicCircuitCache& cache);
+
+	// An element in the numbering of the structure
+	struct Link
+	{
+		uint8_t kind;
+		int node1;
+		int node2;
+
+		bool operator == (const Link& link) const { return kind == link.kind && node1 == link.node1 && node2 == link.node2; }
+	};
+
+	// A circuit numbered by its structure, with the elements and nodes of the circuit at each number
+	struct Canonical
+	{
+		uint64_t topology = 0;
+		uint64_t values = 0;
+		std::vector<Link> links;
+		std::vector<Scalar> voltages;
+		std::vector<Scalar> resistances;
+		std::vector<Element*> elements;
+		std::vector<Node*> nodes;
+	};
+
+	// A topology with its order, or a circuit with what solving it gave (voltage, current and resistance of each element)
+	struct Entry
+	{
+		uint64_t key = 0;
+		bool results = false;
+		std::vector<Link> links;
+		std::vector<Scalar> voltages;
+		std::vector<Scalar> resistances;
+		std::vector<int> order;
+		std::vector<Scalar> solved;
+		Outcome outcome;
+		bool dirty = false;
+		size_t bytes = 0;
+	};
+
+	static void canonicalize(const CircuitCore& circuit, Canonical& canonical);
+	static void apply(CircuitCore& circuit, const Canonical& canonical, const Entry& entry, Outcome& outcome);
+	const Entry* find(uint64_t key, bool results, const Canonical& canonical);
+	void insert(Entry&& entry);
+
+private:
+	size_t _capacity;
+	const Ordering* _ordering;
+
+	mutable std::mutex _mutex;
+	// Most recently used first
+	std::list<Entry> _entries;
+	std::unordered_map<uint64_t, typename std::list<Entry>::iterator> _keys;
+	Stats _stats;
+};
+
+typedef BasicCircuitCache<double> CircuitCache;
+
+#endif // MF_CIRCUIT_CACHE_DEF
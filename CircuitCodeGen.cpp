@@ -0,0 +1,238 @@
+#include "CircuitCodeGen.h"
+#include <cctype>
+#include <sstream>
+
+static thread_local std::vector<std::string> tape;
+
+// Marks every tN mentioned in the expression
+static void markTemporaries(const std::string& expression, std::vector<bool>& needed)
+{
+	for (size_t i = 0; i < expression.size(); ++i)
+	{
+		if (expression[i] != 't' || (i > 0 && isalnum((unsigned char)expression[i - 1])))
+			continue;
+
+		size_t end = i + 1;
+		while (end < expression.size() && isdigit((unsigned char)expression[end]))
+			++end;
+		if (end > i + 1)
+			needed[std::stoi(expression.substr(i + 1, end - i - 1))] = true;
+		i = end - 1;
+	}
+}
+
+/*
+================= Public realization of class TracedScalar =================
+*/
+
+TracedScalar::TracedScalar(double value) : _value(value) { }
+
+TracedScalar TracedScalar::input(int index, double value)
+{
+	TracedScalar result(value);
+	result._name = "values[" + std::to_string(index) + "]";
+	return result;
+}
+
+double TracedScalar::getValue() const { return _value; }
+
+std::string TracedScalar::getExpression() const
+{
+	if (!isConstant())
+		return _name;
+
+	std::ostringstream stream;
+	stream.precision(17);
+	stream << _value;
+
+	std::string literal = stream.str();
+	if (literal.find_first_of(".eEn") == std::string::npos)
+		literal += ".0";
+	return _value < 0 ? "(" + literal + ")" : literal;
+}
+
+bool TracedScalar::isConstant() const { return _name.empty(); }
+
+TracedScalar TracedScalar::operator - () const
+{
+	if (isConstant())
+		return TracedScalar(-_value);
+	return record(-_value, "-" + _name);
+}
+
+TracedScalar& TracedScalar::operator += (const TracedScalar& other) { return *this = *this + other; }
+
+TracedScalar& TracedScalar::operator -= (const TracedScalar& other) { return *this = *this - other; }
+
+TracedScalar& TracedScalar::operator *= (const TracedScalar& other) { return *this = *this * other; }
+
+TracedScalar& TracedScalar::operator /= (const TracedScalar& other) { return *this = *this / other; }
+
+TracedScalar operator + (const TracedScalar& a, const TracedScalar& b)
+{
+	if (a.isConstant() && b.isConstant())
+		return TracedScalar(a._value + b._value);
+	if (a.isConstant() && a._value == 0.0)
+		return b;
+	if (b.isConstant() && b._value == 0.0)
+		return a;
+	return TracedScalar::record(a._value + b._value, a.getExpression() + " + " + b.getExpression());
+}
+
+TracedScalar operator - (const TracedScalar& a, const TracedScalar& b)
+{
+	if (a.isConstant() && b.isConstant())
+		return TracedScalar(a._value - b._value);
+	if (a.isConstant() && a._value == 0.0)
+		return -b;
+	if (b.isConstant() && b._value == 0.0)
+		return a;
+	return TracedScalar::record(a._value - b._value, a.getExpression() + " - " + b.getExpression());
+}
+
+TracedScalar operator * (const TracedScalar& a, const TracedScalar& b)
+{
+	if (a.isConstant() && b.isConstant())
+		return TracedScalar(a._value * b._value);
+
+	// Directions are +1 or -1, and elements that aren't batteries have no voltage
+	if (a.isConstant() || b.isConstant())
+	{
+		const TracedScalar& constant = a.isConstant() ? a : b;
+		const TracedScalar& other = a.isConstant() ? b : a;
+		if (constant._value == 0.0)
+			return TracedScalar(0.0);
+		if (constant._value == 1.0)
+			return other;
+		if (constant._value == -1.0)
+			return -other;
+	}
+	return TracedScalar::record(a._value * b._value, a.getExpression() + " * " + b.getExpression());
+}
+
+TracedScalar operator / (const TracedScalar& a, const TracedScalar& b)
+{
+	if (a.isConstant() && b.isConstant())
+		return TracedScalar(a._value / b._value);
+	if (a.isConstant() && a._value == 0.0)
+		return TracedScalar(0.0);
+	if (b.isConstant() && b._value == 1.0)
+		return a;
+	return TracedScalar::record(a._value / b._value, a.getExpression() + " / " + b.getExpression());
+}
+
+std::ostream& operator << (std::ostream& output, const TracedScalar& value)
+{
+	return output << value._value;
+}
+
+void TracedScalar::startRecording()
+{
+	tape.clear();
+}
+
+const std::vector<std::string>& TracedScalar::getRecording()
+{
+	return tape;
+}
+
+/*
+================= Private realization of class TracedScalar =================
+*/
+
+TracedScalar TracedScalar::record(double value, const std::string& expression)
+{
+	TracedScalar result(value);
+	result._name = "t" + std::to_string(tape.size());
+	tape.push_back("const double " + result._name + " = " + expression + ";");
+	return result;
+}
+
+/*
+================= Public realization of class CircuitCodeGen =================
+*/
+
+CircuitCodeGen::CircuitCodeGen()
+{
+	_circuit = new BasicCircuitCore<TracedScalar>();
+}
+
+CircuitCodeGen::~CircuitCodeGen()
+{
+	delete _circuit;
+}
+
+void CircuitCodeGen::addWire(std::string name, std::string negativeSide, std::string positiveSide)
+{
+	_circuit->addWire(name, negativeSide, positiveSide);
+	_added.push_back({ WIRE, name, TracedScalar(), negativeSide, positiveSide });
+	_descriptions.push_back(name + " (wire, unused)");
+}
+
+void CircuitCodeGen::addResistor(std::string name, double resistance, std::string negativeSide, std::string positiveSide)
+{
+	TracedScalar value = TracedScalar::input((int)_added.size(), resistance);
+	_circuit->addResistor(name, value, negativeSide, positiveSide);
+	_added.push_back({ RESISTOR, name, value, negativeSide, positiveSide });
+	_descriptions.push_back(name + " (resistance)");
+}
+
+void CircuitCodeGen::addBattery(std::string name, double voltage, std::string negativeSide, std::string positiveSide)
+{
+	TracedScalar value = TracedScalar::input((int)_added.size(), voltage);
+	_circuit->addBattery(name, value, negativeSide, positiveSide);
+	_added.push_back({ BATTERY, name, value, negativeSide, positiveSide });
+	_descriptions.push_back(name + " (voltage)");
+}
+
+void CircuitCodeGen::generate(std::ostream& output, std::string functionName)
+{
+	// A solved circuit is dirty, so every call solves a copy
+	BasicCircuitCore<TracedScalar> circuit;
+	std::vector<BasicElement<TracedScalar>*> elements;
+	for (const Added& added : _added)
+	{
+		if (added.kind == WIRE)
+			elements.push_back(circuit.addWire(added.name, added.negativeSide, added.positiveSide));
+		else if (added.kind == RESISTOR)
+			elements.push_back(circuit.addResistor(added.name, added.value, added.negativeSide, added.positiveSide));
+		else
+			elements.push_back(circuit.addBattery(added.name, added.value, added.negativeSide, added.positiveSide));
+	}
+
+	TracedScalar::startRecording();
+	circuit.solve();
+
+	output << "// Generated by CircuitCodeGen, do not edit" << std::endl;
+	output << "// values, currents and voltages:" << std::endl;
+	for (int i = 0; i < (int)_descriptions.size(); ++i)
+		output << "//   " << i << ": " << _descriptions[i] << std::endl;
+
+	output << "inline void " << functionName << "(const double* values, double* currents, double* voltages)" << std::endl;
+	output << "{" << std::endl;
+
+	// Only keep the lines the results depend on, walking back from them
+	const std::vector<std::string>& recording = TracedScalar::getRecording();
+	std::vector<bool> needed(recording.size(), false);
+	std::string results;
+	for (BasicElement<TracedScalar>* element : elements)
+		results += element->getCurrent().getExpression() + " " + element->getVoltage().getExpression() + " ";
+
+	markTemporaries(results, needed);
+	for (int i = (int)recording.size() - 1; i >= 0; --i)
+		if (needed[i])
+			markTemporaries(recording[i].substr(recording[i].find('=')), needed);
+
+	for (int i = 0; i < (int)recording.size(); ++i)
+		if (needed[i])
+			output << "\t" << recording[i] << std::endl;
+
+	// Wires were removed by solve(), they keep zero current like in CircuitCore
+	for (int i = 0; i < (int)elements.size(); ++i)
+	{
+		output << "\tcurrents[" << i << "] = " << elements[i]->getCurrent().getExpression() << ";" << std::endl;
+		output << "\tvoltages[" << i << "] = " << elements[i]->getVoltage().getExpression() << ";" << std::endl;
+	}
+
+	output << "}" << std::endl;
+}
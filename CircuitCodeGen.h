@@ -0,0 +1,113 @@
+#ifndef MF_CIRCUIT_CODEGEN_DEF
+#define MF_CIRCUIT_CODEGEN_DEF
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CircuitCore.h"
+#include "CircuitScalar.h"
+
+/*
+	A number that writes down how it was computed.
+	Every operation on it adds a line of C++ to the current tape, so running the solver
+	on TracedScalars records its whole reduction as straight-line code.
+	Constants (no name) are folded instead of recorded.
+*/
+class TracedScalar
+{
+public:
+	TracedScalar(double value = 0.0);
+
+	static TracedScalar input(int index, double value);
+
+	double getValue() const;
+	std::string getExpression() const;
+	bool isConstant() const;
+
+	TracedScalar operator - () const;
+	TracedScalar& operator += (const TracedScalar& other);
+	TracedScalar& operator -= (const TracedScalar& other);
+	TracedScalar& operator *= (const TracedScalar& other);
+	TracedScalar& operator /= (const TracedScalar& other);
+
+	friend TracedScalar operator + (const TracedScalar& a, const TracedScalar& b);
+	friend TracedScalar operator - (const TracedScalar& a, const TracedScalar& b);
+	friend TracedScalar operator * (const TracedScalar& a, const TracedScalar& b);
+	friend TracedScalar operator / (const TracedScalar& a, const TracedScalar& b);
+	friend std::ostream& operator << (std::ostream& output, const TracedScalar& value);
+
+	// Lines recorded on this thread, until the next startRecording
+	static void startRecording();
+	static const std::vector<std::string>& getRecording();
+
+private:
+	static TracedScalar record(double value, const std::string& expression);
+
+private:
+	double _value = 0.0;
+	std::string _name;
+};
+
+template <>
+class ScalarTraits<TracedScalar>
+{
+public:
+	typedef double Real;
+	typedef TracedScalar Low;
+
+	static constexpr Real zero() { return 0.00001; }
+	static constexpr Real shortCircuit() { return 0.000001; }
+	static bool finite(const TracedScalar& value) { return ScalarTraits<double>::finite(value.getValue()); }
+	static Real magnitude(const TracedScalar& value) { return ScalarTraits<double>::magnitude(value.getValue()); }
+};
+
+/*
+	Runs solve() on sample values and writes the reduction as a standalone C++ function:
+
+		void name(const double* values, double* currents, double* voltages)
+
+	values, currents and voltages are indexed in the order the elements were added
+	(resistance of a resistor, voltage of a battery, nothing for a wire).
+	The function has no branches, so every element has to keep its kind:
+	batteries stay batteries and resistances stay nonzero.
+	Every generate() solves a fresh copy of the added elements, so it can be called again.
+*/
+class CircuitCodeGen
+{
+public:
+	CircuitCodeGen();
+	~CircuitCodeGen();
+
+	void addWire(std::string name, std::string negativeSide, std::string positiveSide);
+	void addResistor(std::string name, double resistance, std::string negativeSide, std::string positiveSide);
+	void addBattery(std::string name, double voltage, std::string negativeSide, std::string positiveSide);
+	void generate(std::ostream& output, std::string functionName);
+
+private:
+	CircuitCodeGen(const CircuitCodeGen& generator);
+	void operator = (const CircuitCodeGen& generator);
+
+	enum Kind
+	{
+		WIRE,
+		RESISTOR,
+		BATTERY
+	};
+
+	struct Added
+	{
+		Kind kind;
+		std::string name;
+		TracedScalar value;
+		std::string negativeSide;
+		std::string positiveSide;
+	};
+
+private:
+	// Checks the elements as they are added, it is never solved
+	BasicCircuitCore<TracedScalar>* _circuit = nullptr;
+	std::vector<Added> _added;
+	std::vector<std::string> _descriptions;
+};
+
+#endif // MF_CIRCUIT_CODEGEN_DEF
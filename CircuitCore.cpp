@@ -1,30 +1,114 @@
 #include "CircuitCore.h"
+#include "CircuitCodeGen.h"
+#include "CircuitNodal.h"
+#include "CircuitTrace.h"
+#include "Subcircuit.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
-#include "math.h"
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+#ifdef MF_SOLVE_STATS
+
+// Adds the time since the last switch to the phase being left, also when solve() returns early
+class PhaseTimer
+{
+public:
+	PhaseTimer(double* phase) : _phase(phase), _mark(std::chrono::steady_clock::now()) { }
+	~PhaseTimer() { next(nullptr); }
+
+	void next(double* phase)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (_phase != nullptr)
+			*_phase += std::chrono::duration<double>(now - _mark).count();
+		_phase = phase;
+		_mark = now;
+	}
+
+private:
+	double* _phase;
+	std::chrono::steady_clock::time_point _mark;
+};
+
+// Keeps the deepest level of a recursion reached, one level per object alive on this thread
+class SolveDepth
+{
+public:
+	SolveDepth(int& deepest) { if (++_level > deepest) deepest = _level; }
+	~SolveDepth() { --_level; }
+
+private:
+	static thread_local int _level;
+};
+
+thread_local int SolveDepth::_level = 0;
+
+#define MF_SOLVE_COUNT(counter, count) (_solveStats.counter += (count))
+#define MF_SOLVE_DEPTH(counter) SolveDepth solveDepth(_solveStats.counter)
+
+#else
+
+class PhaseTimer
+{
+public:
+	PhaseTimer(double*) { }
+	void next(double*) { }
+};
+
+#define MF_SOLVE_COUNT(counter, count) ((void)0)
+#define MF_SOLVE_DEPTH(counter) ((void)0)
+
+#endif
+
+// Heap bytes of a string's text, none while it fits inside the string
+static size_t stringBytes(const std::string& text)
+{
+	const char* inside = reinterpret_cast<const char*>(&text);
+	std::less<const char*> before;
+	if (!before(text.data(), inside) && before(text.data(), inside + sizeof(text)))
+		return 0;
+
+	return text.capacity() + 1;
+}
 
 /*
-================= Public realization of class Node =================
+================= Public realization of class BasicNode =================
 */
 
-Node::Node() { }
+template <typename Scalar>
+BasicNode<Scalar>::BasicNode() { }
 
-Node::Node(std::string name) : _name(name) { }
+template <typename Scalar>
+BasicNode<Scalar>::BasicNode(std::string name) : _name(name) { }
 
-std::string Node::getName() const { return _name; }
+template <typename Scalar>
+std::string BasicNode<Scalar>::getName() const { return _name; }
 
 /*
-================= Public realization of class Element =================
+================= Public realization of class BasicElement =================
 */
 
-std::string Element::getName() const { return _name; }
+template <typename Scalar>
+std::string BasicElement<Scalar>::getName() const { return _name; }
+
+template <typename Scalar>
+Scalar BasicElement<Scalar>::getVoltage() const { return _voltage; }
 
-double Element::getVoltage() const { return _voltage; }
+template <typename Scalar>
+Scalar BasicElement<Scalar>::getResistance() const { return _resistance; }
 
-double Element::getResistance() const { return _resistance; }
+template <typename Scalar>
+Scalar BasicElement<Scalar>::getCurrent() const { return _current; }
 
-double Element::getCurrent() const { return _current; }
+template <typename Scalar>
+BasicElement<Scalar>::BasicElement() { }
 
-Element::Element(std::string name, double voltage, double current, double resistance, Node* node1, Node* node2) {
+template <typename Scalar>
+BasicElement<Scalar>::BasicElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, Node* node1, Node* node2) {
 	_name = name;
 	_voltage = voltage;
 	_current = current;
@@ -34,148 +118,628 @@ Element::Element(std::string name, double voltage, double current, double resist
 }
 
 /*
-================= Public realization of class CircuitCore =================
+================= Public realization of class BasicCircuitCore =================
 */
 
-CircuitCore::CircuitCore(){}
+template <typename Scalar>
+BasicCircuitCore<Scalar>::BasicCircuitCore(){}
 
-CircuitCore::~CircuitCore()
+template <typename Scalar>
+BasicCircuitCore<Scalar>::~BasicCircuitCore()
 {
-	for (Element* element : _elements) delete element;
+	for (Element* element : _elements)
+		if (!element->_pooled)
+			delete element;
+	for (Element* block : _elementBlocks) delete[] block;
 	for (Node* node : _nodes) delete node;
+	for (StarMesh* starMesh : _starMeshes) delete starMesh;
 }
 
-Element* CircuitCore::addWire(std::string name, std::string negativeSide, std::string positiveSide)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::addWire(std::string name, std::string negativeSide, std::string positiveSide)
 {
-	if (negativeSide == positiveSide)
-		throw TWO_SAME_NODES;
+	Element* element = nullptr;
+	Outcome status = tryAddWire(name, negativeSide, positiveSide, &element);
+	if (!status)
+		throw status.error;
 
-	return addElement(name, 0, 0, 0, negativeSide, positiveSide);
+	return element;
 }
 
-Element* CircuitCore::addResistor(std::string name, double resistance, std::string negativeSide, std::string positiveSide)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::addResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide)
 {
-	if (negativeSide == positiveSide)
-		throw TWO_SAME_NODES;
+	Element* element = nullptr;
+	Outcome status = tryAddResistor(name, resistance, negativeSide, positiveSide, &element);
+	if (!status)
+		throw status.error;
 
-	return addElement(name, 0, 0, resistance, negativeSide, positiveSide);
+	return element;
 }
 
-Element* CircuitCore::addBattery(std::string name, double voltage, std::string negativeSide, std::string positiveSide)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::addBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide)
 {
-	if (negativeSide == positiveSide)
-		throw TWO_SAME_NODES;
+	Element* element = nullptr;
+	Outcome status = tryAddBattery(name, voltage, negativeSide, positiveSide, &element);
+	if (!status)
+		throw status.error;
 
-	return addElement(name, voltage, 0, 0, negativeSide, positiveSide);
+	return element;
 }
 
-Element* CircuitCore::removeElement(std::string name)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::removeElement(std::string name)
 {
 	Element* element = searchElement(name);
 	if (element == nullptr)
 		throw NO_ELEMENT_TO_REMOVE;
 
 	removeElement(element);
+	untrack(element);
+
+	// Elements loaded at once share a block the circuit frees, so the caller gets a copy it can delete
+	if (element->_pooled)
+		element = new Element(element->_name, element->_voltage, element->_current, element->_resistance, element->_node1, element->_node2);
 
 	return element;
 }
 
-Element* CircuitCore::searchElement(std::string name) const
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::setValue(std::string name, Scalar value)
 {
+	Outcome status = trySetValue(name, value);
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::searchElement(const std::string& name) const
+{
+	auto found = _elementsByName.find(name);
+	return found != _elementsByName.end() ? found->second : nullptr;
+}
+
+template <typename Scalar>
+mf::LinkedList<BasicElement<Scalar>*> BasicCircuitCore<Scalar>::getElementsList() const
+{
+	mf::LinkedList<Element*> elements;
 	for (Element* element : _elements)
+		elements.pushBack(element);
+	return elements;
+}
+
+template <typename Scalar>
+BasicPortModel<Scalar> BasicCircuitCore<Scalar>::reducePorts(const mf::LinkedList<std::string>& ports) const
+{
+	PortModel model;
+	Outcome status = tryReducePorts(ports, model);
+	if (!status)
+		throw status.error;
+
+	return model;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::addPortModel(std::string name, const PortModel& model, const mf::LinkedList<std::string>& nodes)
+{
+	Outcome status = tryAddPortModel(name, model, nodes);
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::addSubcircuit(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes)
+{
+	Outcome status = tryAddSubcircuit(name, definition, nodes);
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::solve()
+{
+	Outcome status = trySolve();
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::solveNodal(const Ordering* ordering, Precision precision)
+{
+	Outcome status = trySolveNodal(ordering, precision);
+	if (!status)
+		throw status.error;
+}
+
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::dirty() const
+{
+	return isDirty;
+}
+
+template <typename Scalar>
+const CircuitBase::SolveStats& BasicCircuitCore<Scalar>::getSolveStats() const
+{
+	return _solveStats;
+}
+
+template <typename Scalar>
+CircuitBase::MemoryStats BasicCircuitCore<Scalar>::getMemoryStats() const
+{
+	measureMemory();
+	return _memoryStats;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::trackMemory(bool track)
+{
+	_trackMemory = track;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::reserve(int elements, int nodes)
+{
+	_elementsByName.reserve(elements);
+	_nodesByName.reserve(nodes);
+	_added.reserve(elements);
+}
+
+template <typename Scalar>
+BasicResultView<Scalar> BasicCircuitCore<Scalar>::getResults() const
+{
+	return ResultView(_results.data(), (int)_results.size());
+}
+
+template <typename Scalar>
+const std::string& BasicCircuitCore<Scalar>::getResultName(int nameId) const
+{
+	return _added[nameId]->_name;
+}
+
+template <typename Scalar>
+int BasicCircuitCore<Scalar>::copyResults(Scalar* voltages, Scalar* currents, Scalar* resistances, int capacity) const
+{
+	int count = std::min(capacity, (int)_results.size());
+	for (int i = 0; i < count; ++i)
 	{
-		if (element->getName() == name)
-			return element;
+		if (voltages != nullptr) voltages[i] = _results[i].voltage;
+		if (currents != nullptr) currents[i] = _results[i].current;
+		if (resistances != nullptr) resistances[i] = _results[i].resistance;
 	}
-	return nullptr;
+	return count;
+}
+
+template <typename Scalar>
+BasicResultView<Scalar, BasicNodeResult<Scalar>> BasicCircuitCore<Scalar>::getNodeResults() const
+{
+	// Most solves never ask for them, so they are found the first time they are needed
+	if (_nodeResults.empty() && !_results.empty())
+		collectPotentials();
+
+	return NodeResultView(_nodeResults.data(), (int)_nodeResults.size());
+}
+
+template <typename Scalar>
+const std::string& BasicCircuitCore<Scalar>::getNodeResultName(int nameId) const
+{
+	return _resultNodes[nameId]->_name;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddWire(std::string name, std::string negativeSide, std::string positiveSide, Element** added)
+{
+	if (negativeSide == positiveSide)
+		return Outcome::failure(TWO_SAME_NODES, name, negativeSide);
+
+	Element* element = nullptr;
+	Outcome outcome = tryAddElement(name, 0, 0, 0, negativeSide, positiveSide, &element);
+	if (!outcome)
+		return outcome;
+
+	track(element);
+	if (added != nullptr)
+		*added = element;
+	return outcome;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide, Element** added)
+{
+	if (negativeSide == positiveSide)
+		return Outcome::failure(TWO_SAME_NODES, name, negativeSide);
+
+	Element* element = nullptr;
+	Outcome outcome = tryAddElement(name, 0, 0, resistance, negativeSide, positiveSide, &element);
+	if (!outcome)
+		return outcome;
+
+	track(element);
+	if (added != nullptr)
+		*added = element;
+	return outcome;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide, Element** added)
+{
+	if (negativeSide == positiveSide)
+		return Outcome::failure(TWO_SAME_NODES, name, negativeSide);
+
+	Element* element = nullptr;
+	Outcome outcome = tryAddElement(name, voltage, 0, 0, negativeSide, positiveSide, &element);
+	if (!outcome)
+		return outcome;
+
+	track(element);
+	if (added != nullptr)
+		*added = element;
+	return outcome;
 }
 
-mf::LinkedList<Element*> CircuitCore::getElementsList() const
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryRemoveElement(std::string name)
 {
-	return _elements;
+	Element* element = searchElement(name);
+	if (element == nullptr)
+		return Outcome::failure(NO_ELEMENT_TO_REMOVE, name);
+
+	removeElement(element);
+	untrack(element);
+
+	// Nobody else holds it, pooled ones go with their block
+	if (!element->_pooled)
+		delete element;
+
+	return Outcome();
 }
 
-void CircuitCore::solve()
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::trySetValue(std::string name, Scalar value)
 {
 	if (dirty())
-		throw DIRTY_CIRCUIT;
+		return Outcome::failure(DIRTY_CIRCUIT);
+
+	Element* element = searchElement(name);
+	if (element == nullptr)
+		return Outcome::failure(NO_ELEMENT, name);
+
+	// What the element was added as decides which value changes, so a resistor can go to 0 and back
+	if (element->_battery)
+		element->_voltage = value;
+	else
+		element->_resistance = value;
 
-	validate();
+	_results.clear();
+	_nodeResults.clear();
+	return Outcome();
+}
 
-	// Remove wires
-	for (int i = 0; i < _elements.getSize(); ++i)
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryReducePorts(const mf::LinkedList<std::string>& ports, PortModel& model) const
+{
+	if (dirty())
+		return Outcome::failure(DIRTY_CIRCUIT);
+
+	mf::LinkedList<Node*> portNodes;
+	for (const std::string& port : ports)
 	{
-		Element* element = _elements[i];
-		if (isWire(element)){
-			removeAndBindElement(element);
-			i = -1;
-		}
+		Node* node = searchNode(port);
+		if (node == nullptr)
+			return Outcome::failure(NO_NODE, "", port);
+		portNodes.pushBack(node);
 	}
 
-	bool allowMergeWithBattery = false;
-	while (_elements.getSize() != 1)
+	BasicNodalSystem<Scalar> system(*this);
+	if (!system.getOutcome())
+		return system.getOutcome();
+
+	return system.reduce(portNodes, model);
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddPortModel(std::string name, const PortModel& model, const mf::LinkedList<std::string>& nodes)
+{
+	int size = model.getPortCount();
+	if (nodes.getSize() != size)
+		return Outcome::failure(PORT_COUNT_MISMATCH, name);
+
+	for (int i = 0; i < size - 1; ++i)
+		for (int j = i + 1; j < size; ++j)
+			if (nodes[i] == nodes[j])
+				return Outcome::failure(TWO_SAME_NODES, name, nodes[i]);
+
+	/*
+		Admittances are conductances, not resistances, and a megohm network has tiny ones,
+		so only what is rounding noise next to the largest entry counts as no connection
+	*/
+	Real largest = 0;
+	for (int i = 0; i < size; ++i)
+		for (int j = 0; j < size; ++j)
+			largest = std::max(largest, ScalarTraits<Scalar>::magnitude(model.getAdmittance(i, j)));
+	Real negligible = largest * std::numeric_limits<Real>::epsilon() * 1024;
+
+	/*
+		A resistor between every two ports with Gij = -Yij.
+		The source currents J are carried by batteries inside those resistors,
+		so we pick a spanning tree and push the current of each port towards the root
+	*/
+	std::vector<int> parents(size, -1);
+	std::vector<int> order;
+	std::vector<bool> visited(size, false);
+	for (int root = 0; root < size; ++root)
 	{
-		for (int i = 0; i < _elements.getSize() - 1; ++i)
+		if (visited[root])
+			continue;
+
+		visited[root] = true;
+		order.push_back(root);
+		for (int k = (int)order.size() - 1; k < (int)order.size(); ++k)
 		{
-			for (int j = i + 1; j < _elements.getSize(); ++j)
+			int i = order[k];
+			for (int j = 0; j < size; ++j)
 			{
-				Element* el1 = _elements[i];
-				Element* el2 = _elements[j];
-				int cxn = connection(el1, el2);
-
-				if (cxn == NONE)
+				if (visited[j] || ScalarTraits<Scalar>::magnitude(model.getAdmittance(i, j)) <= negligible)
 					continue;
-				if (!allowMergeWithBattery)
-					if (isBattery(el1) || isBattery(el2))
-						continue;
-
-				merge(el1, el2);
-				goto exit;
+				visited[j] = true;
+				parents[j] = i;
+				order.push_back(j);
 			}
 		}
-		if (!allowMergeWithBattery)
-			allowMergeWithBattery = true;
-		else
+	}
+
+	// Current each port has to push through the battery towards its parent
+	std::vector<Scalar> flows(size, Scalar(0));
+	for (int i = 0; i < size; ++i)
+		flows[i] = -model.getSourceCurrent(i);
+	for (int k = size - 1; k >= 0; --k)
+	{
+		int i = order[k];
+		if (parents[i] != -1)
+			flows[parents[i]] += flows[i];
+	}
+
+	if (searchElement(name))
+		return Outcome::failure(ELEMENT_ALREADY_EXIST, name);
+
+	// Every name is checked before the first element is added, so a failure adds nothing
+	auto elementName = [&](int i, int j) { return name + "[" + model.getPortName(i) + "," + model.getPortName(j) + "]"; };
+	std::unordered_set<std::string> names;
+	for (int i = 0; i < size - 1; ++i)
+	{
+		for (int j = i + 1; j < size; ++j)
 		{
-			isDirty = true;
-			throw NOT_SERIES_NOT_PARALLEL;
+			if (ScalarTraits<Scalar>::magnitude(model.getAdmittance(i, j)) <= negligible)
+				continue;
+			std::string added = elementName(i, j);
+			if (searchElement(added) || !names.insert(added).second)
+				return Outcome::failure(ELEMENT_ALREADY_EXIST, added);
 		}
+	}
+
+	for (int i = 0; i < size - 1; ++i)
+	{
+		for (int j = i + 1; j < size; ++j)
+		{
+			Scalar conductance = -model.getAdmittance(i, j);
+			if (ScalarTraits<Scalar>::magnitude(conductance) <= negligible)
+				continue;
+
+			// The current leaving node i through the element is G * (Vi - Vj) + G * E
+			Scalar voltage = 0.0;
+			if (parents[j] == i)
+				voltage = -flows[j] / conductance;
+			if (parents[i] == j)
+				voltage = flows[i] / conductance;
 
-	exit:;
+			Element* element = nullptr;
+			tryAddElement(elementName(i, j), voltage, 0, Scalar(1) / conductance, nodes[i], nodes[j], &element);
+			track(element);
+		}
 	}
 
-	Element* leftoverElement = _elements[0];
-	leftoverElement->_current = leftoverElement->_voltage / leftoverElement->_resistance;
+	return Outcome();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddSubcircuit(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes)
+{
+	if (nodes.getSize() != definition.getPortCount())
+		return Outcome::failure(PORT_COUNT_MISMATCH, name);
+
+	const PortModel* model = nullptr;
+	Outcome status = definition.tryGetModel(model);
+	if (!status)
+		return status;
+
+	return tryAddPortModel(name, *model, nodes);
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::trySolve()
+{
+	if (dirty())
+		return Outcome::failure(DIRTY_CIRCUIT);
+
+	TraceSpan span("CircuitCore::solve");
+	TraceSpan phase("validate");
+	_solveStats = SolveStats();
+	PhaseTimer timer(&_solveStats.validate);
+	_memoryStats.validate = _memoryStats.wireRemoval = _memoryStats.reduction = _memoryStats.unmerge = 0;
+	switchMemoryPhase(nullptr, &_memoryStats.validate);
+
+	Outcome status = validate();
+	if (!status)
+		return status;
+
+	/*
+		Errors that only a broken merge tree can cause (like MERGE_FAILED) are still thrown inside,
+		catching them costs nothing while nothing is thrown
+	*/
+	try
+	{
+		// Remove wires
+		timer.next(&_solveStats.wireRemoval);
+		phase.next("wire removal");
+		switchMemoryPhase(&_memoryStats.validate, &_memoryStats.wireRemoval);
+		for (int i = 0; i < _elements.getSize(); ++i)
+		{
+			Element* element = _elements[i];
+			if (isWire(element)){
+				status = removeAndBindElement(element);
+				if (!status)
+				{
+					isDirty = true;
+					return status;
+				}
+				MF_SOLVE_COUNT(wiresRemoved, 1);
+				i = -1;
+			}
+		}
+
+		timer.next(&_solveStats.reduction);
+		phase.next("reduction");
+		switchMemoryPhase(&_memoryStats.wireRemoval, &_memoryStats.reduction);
+		bool allowMergeWithBattery = false;
+		// Star-mesh empties a node and mesh-star empties a corner for one new center,
+		// so this bound is never reached, it only guards against a transform that goes in circles
+		int transformsLeft = 4 * _nodes.getSize();
+		_maxStarMeshDegree = defaultStarMeshDegree;
+		while (_elements.getSize() != 1)
+		{
+			for (int i = 0; i < _elements.getSize() - 1; ++i)
+			{
+				for (int j = i + 1; j < _elements.getSize(); ++j)
+				{
+					Element* el1 = _elements[i];
+					Element* el2 = _elements[j];
+					int cxn = connection(el1, el2);
+
+					if (cxn == NONE)
+						continue;
+					if (!allowMergeWithBattery)
+						if (isBattery(el1) || isBattery(el2))
+							continue;
+
+					status = merge(el1, el2);
+					if (!status)
+					{
+						// An ideal battery parallel to part of the circuit is fine if the rest still reduces to that part
+						if (status.error == SHORT_CIRCUIT_WITH_BATTERY && transformsLeft-- > 0 && transform())
+						{
+							allowMergeWithBattery = false;
+							goto exit;
+						}
+						isDirty = true;
+						return status;
+					}
+					goto exit;
+				}
+			}
+			if (!allowMergeWithBattery)
+				allowMergeWithBattery = true;
+			else if (transformsLeft-- > 0 && transform())
+				allowMergeWithBattery = false;
+			else
+			{
+				isDirty = true;
+				return Outcome::failure(NOT_SERIES_NOT_PARALLEL);
+			}
+
+		exit:;
+		}
+
+		timer.next(&_solveStats.unmerge);
+		phase.next("unmerge");
+		switchMemoryPhase(&_memoryStats.reduction, &_memoryStats.unmerge);
+		Element* leftoverElement = _elements[0];
+		leftoverElement->_current = leftoverElement->_voltage / leftoverElement->_resistance;
+
+		unmerge(leftoverElement);
+	}
+	catch (Errors error)
+	{
+		isDirty = true;
+		return Outcome::failure(error);
+	}
 
-	unmerge(leftoverElement);
 	isDirty = true;
+	collectResults();
+	switchMemoryPhase(&_memoryStats.unmerge, nullptr);
+	return Outcome();
 }
 
-bool CircuitCore::dirty() const
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::trySolveNodal(const Ordering* ordering, Precision precision)
 {
-	return isDirty;
+	if (dirty())
+		return Outcome::failure(DIRTY_CIRCUIT);
+
+	TraceSpan span("CircuitCore::solveNodal");
+	_memoryStats.nodal = 0;
+	Outcome status = validate();
+	if (!status)
+		return status;
+
+	// Unlike solve(), this works for every circuit, but builds and factorizes the whole matrix
+	BasicNodalSystem<Scalar> system(*this);
+	if (!system.getOutcome())
+		return system.getOutcome();
+
+	AutoOrdering automatic;
+	system.solve(ordering != nullptr ? *ordering : automatic, precision == MIXED_PRECISION);
+	if (_trackMemory)
+	{
+		measureMemory();
+		_memoryStats.nodal = _memoryStats.current + system.getSolveBytes();
+		_memoryStats.peak = std::max(_memoryStats.peak, _memoryStats.nodal);
+	}
+
+	isDirty = true;
+	if (system.getOutcome())
+		collectResults();
+	return system.getOutcome();
 }
 
 /*
-================= Private realization of class CircuitCore =================
+================= Private realization of class BasicCircuitCore =================
 */
 
-Element* CircuitCore::addElement(std::string name, double voltage, double current, double resistance, std::string negativeSide, std::string positiveSide)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::addElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, std::string negativeSide, std::string positiveSide)
 {
-	if (searchElement(name))
-		throw ELEMENT_ALREADY_EXIST;
+	Element* element = nullptr;
+	Outcome status = tryAddElement(name, voltage, current, resistance, negativeSide, positiveSide, &element);
+	if (!status)
+		throw status.error;
+
+	return element;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAddElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, std::string negativeSide, std::string positiveSide, Element** added)
+{
+	// One lookup both checks the name and reserves it
+	auto named = _elementsByName.try_emplace(name, nullptr);
+	if (!named.second)
+		return Outcome::failure(ELEMENT_ALREADY_EXIST, name);
 
 	Node* node1 = searchOrCreateNode(negativeSide);
 	Node* node2 = searchOrCreateNode(positiveSide);
 	Element* element = new Element(name, voltage, current, resistance, node1, node2);
+	named.first->second = element;
 
-	_elements.pushFront(element);
-	node1->_elements.pushBack(element);
-	node2->_elements.pushBack(element);
-	return element;
+	element->_inCircuit = _elements.pushFront(element);
+	element->_inNode1 = node1->_elements.pushBack(element);
+	element->_inNode2 = node2->_elements.pushBack(element);
+
+	if (added != nullptr)
+		*added = element;
+	return Outcome();
 }
 
-Element * CircuitCore::addElement(Element * element)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::addElement(Element * element)
 {
 	if (searchElement(element->getName()))
 		throw ELEMENT_ALREADY_EXIST;
@@ -185,25 +749,78 @@ Element * CircuitCore::addElement(Element * element)
 	Node* node2 = searchOrCreateNode(element->_node2->getName());
 
 	// Attach element to circuit
-	_elements.pushFront(element);
+	element->_inCircuit = _elements.pushFront(element);
+	_elementsByName[element->getName()] = element;
 
 	// Attach element to nodes
-	node1->_elements.pushBack(element);
-	node2->_elements.pushBack(element);
+	element->_inNode1 = node1->_elements.pushBack(element);
+	element->_inNode2 = node2->_elements.pushBack(element);
 
 	return element;
 }
 
-Element* CircuitCore::removeElement(Element * element)
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::allocateElements(int count)
+{
+	Element* block = new Element[count];
+	for (int i = 0; i < count; ++i)
+		block[i]._pooled = true;
+	_elementBlocks.push_back(block);
+
+	return block;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::tryAttach(Element* element)
 {
-	element->_node1->_elements.remove(element);
-	element->_node2->_elements.remove(element);
-	_elements.remove(element);
+	// Same as tryAddElement for an element whose name, values and nodes are already set
+	auto named = _elementsByName.try_emplace(element->_name, element);
+	if (!named.second)
+		return Outcome::failure(ELEMENT_ALREADY_EXIST, element->_name);
+
+	element->_inCircuit = _elements.pushFront(element);
+	element->_inNode1 = element->_node1->_elements.pushBack(element);
+	element->_inNode2 = element->_node2->_elements.pushBack(element);
+	track(element);
+
+	return Outcome();
+}
+
+template <typename Scalar>
+BasicElement<Scalar>* BasicCircuitCore<Scalar>::removeElement(Element * element)
+{
+	unlink(element);
 
 	return element;
 }
 
-void CircuitCore::removeAndBindElement(Element* element)
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::unlink(Element * element)
+{
+	if (element->_inNode1 != nullptr)
+	{
+		element->_node1->_elements.erase(element->_inNode1);
+		MF_SOLVE_COUNT(listRemovals, 1);
+	}
+	if (element->_inNode2 != nullptr)
+	{
+		element->_node2->_elements.erase(element->_inNode2);
+		MF_SOLVE_COUNT(listRemovals, 1);
+	}
+	if (element->_inCircuit != _elements.end())
+	{
+		_elements.erase(element->_inCircuit);
+		_elementsByName.erase(element->getName());
+		MF_SOLVE_COUNT(listRemovals, 1);
+	}
+
+	element->_inNode1 = nullptr;
+	element->_inNode2 = nullptr;
+	element->_inCircuit = _elements.end();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::removeAndBindElement(Element* element)
 {
 	// We save a node, attach other elements to it, and remove the other one
 	Node* savedNode = element->_node1;
@@ -236,34 +853,39 @@ void CircuitCore::removeAndBindElement(Element* element)
 		}
 
 	if (isParallel && isWire(element))
-		throw SHORT_CIRCUIT;
+		return Outcome::failure(SHORT_CIRCUIT, element->getName(), element->_node1->getName());
 
 	if (!isParallel)
 	{
 		while (notSavedNode->_elements.getSize() != 0)
 		{
-			Element* other = notSavedNode->_elements.getHead()->getData();
+			mf::ListNode<Element*>* entry = notSavedNode->_elements.getHead();
+			Element* other = entry->getData();
 
+			MF_SOLVE_COUNT(listRemovals, 1);
 			if (other == element)
 			{
-				notSavedNode->_elements.remove(element);
+				notSavedNode->_elements.erase(entry);
+				if (element->_inNode1 == entry)
+					element->_inNode1 = nullptr;
+				else
+					element->_inNode2 = nullptr;
 				continue;
 			}
 
-			// Attach the savedNode to the element
-			if (other->_node1 == notSavedNode)
+			// Deattach the other element from the old node,
+			// and attach it to the saved node (new node)
+			notSavedNode->_elements.erase(entry);
+			if (other->_inNode1 == entry)
 			{
 				other->_node1 = savedNode;
+				other->_inNode1 = savedNode->_elements.pushFront(other);
 			}
-			else if (other->_node2 == notSavedNode)
+			else
 			{
 				other->_node2 = savedNode;
+				other->_inNode2 = savedNode->_elements.pushFront(other);
 			}
-
-			// Deattach the other element from the old node
-			notSavedNode->_elements.remove(other);
-			// Attach the other element to the saved node (new node)
-			savedNode->_elements.pushFront(other);
 		}
 	}
 
@@ -271,66 +893,129 @@ void CircuitCore::removeAndBindElement(Element* element)
 	if (notSavedNode->_elements.getSize() == 0)
 	{
 		_nodes.remove(notSavedNode);
+		_nodesByName.erase(notSavedNode->getName());
 		notSavedNode = nullptr;
+		MF_SOLVE_COUNT(listRemovals, 1);
 	}
 
-	// Deattach the element from its node
-	element->_node1->_elements.remove(element);
-	if (notSavedNode != nullptr)
-		element->_node2->_elements.remove(element);
+	// Deattach the element from its node and from circuit
+	unlink(element);
 
-	// Deattach from circuit
-	_elements.remove(element);
-	
+	return Outcome();
 }
 
-void CircuitCore::validate() const
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::validate() const
 {
 	if (_elements.getSize() == 0)
-		throw NO_ELEMENT;
+		return Outcome::failure(NO_ELEMENT);
 
 	int batteryCount = 0;
 	int resistorCount = 0;
 	for (Element* element : _elements)
 	{
 		if (isBattery(element)) ++batteryCount;
-		if (element->_resistance > 0) ++resistorCount;
+		if (ScalarTraits<Scalar>::magnitude(element->_resistance) > 0) ++resistorCount;
 
 		if (element->_node1->_elements.getSize() == 1)
-			throw NOT_CONNECTED;
+			return Outcome::failure(NOT_CONNECTED, element->getName(), element->_node1->getName());
 		if (element->_node2->_elements.getSize() == 1)
-			throw NOT_CONNECTED;
+			return Outcome::failure(NOT_CONNECTED, element->getName(), element->_node2->getName());
+	}
+
+	if (batteryCount == 0) return Outcome::failure(NO_VOLTAGE_SOURCE);
+	if (resistorCount == 0) return Outcome::failure(NO_RESISTOR);
+
+	return Outcome();
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::measureMemory() const
+{
+	MemoryStats& stats = _memoryStats;
+	stats.elements = stats.nodes = stats.lists = stats.lookup = stats.results = 0;
+
+	// Merged elements hold their children until unmerge, and star-mesh records the elements they replaced
+	std::vector<const Element*> pending;
+	for (Element* element : _elements)
+		pending.push_back(element);
+	for (StarMesh* starMesh : _starMeshes)
+	{
+		stats.lists += sizeof(StarMesh) + starMesh->_sources.getBytes() + starMesh->_results.getBytes();
+		for (Element* source : starMesh->_sources)
+			pending.push_back(source);
 	}
+	while (!pending.empty())
+	{
+		const Element* element = pending.back();
+		pending.pop_back();
+		stats.elements += sizeof(Element) + stringBytes(element->_name);
+		if (element->_left != nullptr)
+			pending.push_back(element->_left);
+		if (element->_right != nullptr)
+			pending.push_back(element->_right);
+	}
+
+	for (Node* node : _nodes)
+	{
+		stats.nodes += sizeof(Node) + stringBytes(node->_name);
+		stats.lists += node->_elements.getBytes();
+	}
+	stats.lists += _elements.getBytes() + _nodes.getBytes() + _starMeshes.getBytes();
+
+	// A table node is the entry, its key's text, the next pointer and the cached hash
+	stats.lookup += _elementsByName.bucket_count() * sizeof(void*) + _nodesByName.bucket_count() * sizeof(void*);
+	for (const auto& named : _elementsByName)
+		stats.lookup += sizeof(named) + 2 * sizeof(void*) + stringBytes(named.first);
+	for (const auto& named : _nodesByName)
+		stats.lookup += sizeof(named) + 2 * sizeof(void*) + stringBytes(named.first);
+
+	stats.results += _added.capacity() * sizeof(Element*) + _results.capacity() * sizeof(ElementResult);
+	stats.results += _resultNodes.capacity() * sizeof(Node*) + _nodeResults.capacity() * sizeof(NodeResult);
+	stats.results += _elementBlocks.capacity() * sizeof(Element*);
+
+	stats.current = stats.elements + stats.nodes + stats.lists + stats.lookup + stats.results;
+	stats.peak = std::max(stats.peak, stats.current);
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::switchMemoryPhase(size_t* leaving, size_t* entering)
+{
+	if (!_trackMemory)
+		return;
 
-	if (batteryCount == 0) throw NO_VOLTAGE_SOURCE;
-	if (resistorCount == 0) throw NO_RESISTOR;
+	measureMemory();
+	if (leaving != nullptr)
+		*leaving = std::max(*leaving, _memoryStats.current);
+	if (entering != nullptr)
+		*entering = std::max(*entering, _memoryStats.current);
 }
 
-Element * CircuitCore::merge(Element * el1, Element * el2)
+template <typename Scalar>
+CircuitBase::Outcome BasicCircuitCore<Scalar>::merge(Element * el1, Element * el2)
 {
 	int cxn = connection(el1, el2);
 	if (cxn == NONE)
 		throw MERGE_FAILED;
-	/*
-		Are batteries in the same direction or not?
-		if not, negative the voltage of one of them
-	*/
-	if (isBattery(el1) && isBattery(el2))
-		if (el1->_node1 == el2->_node1 || el1->_node2 == el2->_node2)
-			el2->_voltage *= -1;
-
 	// Construct new element
 	std::string name = el1->getName() + "+" + el2->getName();
-	double voltage = 0.0;
-	double current = 0.0;
-	double resistance = 0.0;
+	Scalar voltage = 0.0;
+	Scalar current = 0.0;
+	Scalar resistance = 0.0;
 	Node * node1 = nullptr;
 	Node * node2 = nullptr;
 
+	/*
+		Direction of each child compared to the new element.
+		1 means going from node1 to node2 of the new element passes the child
+		from its own node1 to its node2, -1 means it passes the child backwards
+	*/
+	int leftDirection = 1;
+	int rightDirection = 1;
+
 	if (cxn == SERIES)
 	{
 		resistance = el1->_resistance + el2->_resistance;
-		voltage = el1->_voltage + el2->_voltage;
 
 		// Remove the common node and save the other nodes for further using
 		Node* commonNode = nullptr;
@@ -342,6 +1027,9 @@ Element * CircuitCore::merge(Element * el1, Element * el2)
 		node1 = el1->_node1 == commonNode ? el1->_node2 : el1->_node1;
 		node2 = el2->_node1 == commonNode ? el2->_node2 : el2->_node1;
 
+		leftDirection = el1->_node2 == commonNode ? 1 : -1;
+		rightDirection = el2->_node1 == commonNode ? 1 : -1;
+
 		/*
 		   The first node of battery, is its negative side
 		   and the second node of battery is its possitive side
@@ -355,6 +1043,8 @@ Element * CircuitCore::merge(Element * el1, Element * el2)
 				Node* temp = node1;
 				node1 = node2;
 				node2 = temp;
+				leftDirection *= -1;
+				rightDirection *= -1;
 			}
 		}
 
@@ -365,6 +1055,8 @@ Element * CircuitCore::merge(Element * el1, Element * el2)
 				Node* temp = node1;
 				node1 = node2;
 				node2 = temp;
+				leftDirection *= -1;
+				rightDirection *= -1;
 			}
 		}
 
@@ -375,54 +1067,80 @@ Element * CircuitCore::merge(Element * el1, Element * el2)
 				Node* temp = node1;
 				node1 = node2;
 				node2 = temp;
+				leftDirection *= -1;
+				rightDirection *= -1;
 			}
 		}
+
+		/*
+			Batteries facing each other cancel out, so we sum the voltages
+			along the direction of the new element
+		*/
+		voltage = Scalar(leftDirection) * el1->_voltage + Scalar(rightDirection) * el2->_voltage;
 	}
 
 	if (cxn == PARALLEL)
 	{
 		// Check short circuit. It may happen when an element is parallel with a battery
-		if (el1->_resistance < 0.000001 || el2->_resistance < 0.000001)
-			throw SHORT_CIRCUIT_WITH_BATTERY;
-
-		if (abs(el1->_voltage) > 0.00001 || abs(el2->_voltage) > 0.00001)
-			throw NOT_SERIES_NOT_PARALLEL;
+		if (ScalarTraits<Scalar>::magnitude(el1->_resistance) < ScalarTraits<Scalar>::shortCircuit())
+			return Outcome::failure(SHORT_CIRCUIT_WITH_BATTERY, el1->getName(), el1->_node1->getName());
+		if (ScalarTraits<Scalar>::magnitude(el2->_resistance) < ScalarTraits<Scalar>::shortCircuit())
+			return Outcome::failure(SHORT_CIRCUIT_WITH_BATTERY, el2->getName(), el2->_node1->getName());
 
-		resistance = 1.0 / (1.0 / el1->_resistance + 1.0 / el2->_resistance);
+		resistance = Scalar(1) / (Scalar(1) / el1->_resistance + Scalar(1) / el2->_resistance);
 		node1 = el1->_node1;
 		node2 = el1->_node2;
+		rightDirection = el2->_node1 == el1->_node1 ? 1 : -1;
+
+		// Batteries with resistance (like a Thevenin equivalent) follow Millman's theorem
+		voltage = (el1->_voltage / el1->_resistance + Scalar(rightDirection) * el2->_voltage / el2->_resistance) * resistance;
 	}
 
 	if (node1 == nullptr || node2 == nullptr)
 		throw MERGE_FAILED;
 
 	Element * newElement = addElement(name, voltage, current, resistance, node1->getName(), node2->getName());
+	MF_SOLVE_COUNT(allocations, 1);
+	if (cxn == SERIES)
+		MF_SOLVE_COUNT(seriesMerges, 1);
+	else
+		MF_SOLVE_COUNT(parallelMerges, 1);
 
 	newElement->_left = el1;
 	newElement->_right = el2;
+	newElement->_leftDirection = leftDirection;
+	newElement->_rightDirection = rightDirection;
 	newElement->_childrenConnections = cxn;
 
 	removeElement(el1);
 	removeElement(el2);
 
 	if (node1->_elements.getSize() < 2)
-		throw SHORT_CIRCUIT;
+		return Outcome::failure(SHORT_CIRCUIT, newElement->getName(), node1->getName());
 	if (node2->_elements.getSize() < 2)
-		throw SHORT_CIRCUIT;
+		return Outcome::failure(SHORT_CIRCUIT, newElement->getName(), node2->getName());
 
-	return newElement;
+	return Outcome();
 }
 
-void CircuitCore::unmerge(Element * element)
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::unmerge(Element * element)
 {
+	MF_SOLVE_DEPTH(unmergeDepth);
+	if (element->_childrenConnections == STAR_MESH)
+	{
+		unmergeStarMesh(element);
+		return;
+	}
+
 	if (element->_left == nullptr && element->_right == nullptr)
 	{
-		if (!_elements.find(element))
+		if (element->_inCircuit == _elements.end())
 			addElement(element);
-		if (!element->_node1->_elements.find(element))
-			element->_node1->_elements.pushFront(element);
-		if (!element->_node2->_elements.find(element))
-			element->_node2->_elements.pushFront(element);
+		if (element->_inNode1 == nullptr)
+			element->_inNode1 = element->_node1->_elements.pushFront(element);
+		if (element->_inNode2 == nullptr)
+			element->_inNode2 = element->_node2->_elements.pushFront(element);
 		if (!isBattery(element))
 			element->_voltage = element->_current * element->_resistance;
 
@@ -431,7 +1149,7 @@ void CircuitCore::unmerge(Element * element)
 
 	Element* left = element->_left;
 	Element* right = element->_right;
-	double current = element->_current;
+	Scalar current = element->_current;
 
 	if (left == nullptr || right == nullptr)
 		throw UNMERGE_FAILED;
@@ -439,22 +1157,23 @@ void CircuitCore::unmerge(Element * element)
 	// Divide current
 	if (element->_childrenConnections == SERIES)
 	{
-		left->_current = current;
-		right->_current = current;
+		left->_current = Scalar(element->_leftDirection) * current;
+		right->_current = Scalar(element->_rightDirection) * current;
 	}
 
 	if (element->_childrenConnections == PARALLEL)
 	{
 		// Check short circuit
-		if (left->_resistance < 0.000001)
-			left->_current = current;
-		else if (right->_resistance < 0.000001)
-			right->_current = current;
+		if (ScalarTraits<Scalar>::magnitude(left->_resistance) < ScalarTraits<Scalar>::shortCircuit())
+			left->_current = Scalar(element->_leftDirection) * current;
+		else if (ScalarTraits<Scalar>::magnitude(right->_resistance) < ScalarTraits<Scalar>::shortCircuit())
+			right->_current = Scalar(element->_rightDirection) * current;
 		else {
-			double ratio = left->_resistance / right->_resistance;
+			// Both children see the same voltage, V2 - V1 = E - I * R
+			Scalar voltage = element->_voltage - current * element->_resistance;
 
-			left->_current = current / (ratio + 1);
-			right->_current = ratio * current / (ratio + 1);
+			left->_current = (left->_voltage - Scalar(element->_leftDirection) * voltage) / left->_resistance;
+			right->_current = (right->_voltage - Scalar(element->_rightDirection) * voltage) / right->_resistance;
 		}
 	}
 
@@ -462,15 +1181,270 @@ void CircuitCore::unmerge(Element * element)
 	unmerge(right);
 
 	// Remove element footsteps from circuit
-	element->_node1->_elements.remove(element);
-	element->_node2->_elements.remove(element);
-	_elements.remove(element);
+	unlink(element);
 
 	delete element;
 }
 
-int CircuitCore::connection(Element * el1, Element * el2) const
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::transform()
+{
+	// Eliminate the passive node with the lowest degree (star-mesh)
+	Node* center = nullptr;
+	for (Node* node : _nodes)
+	{
+		int degree = node->_elements.getSize();
+		if (degree < 3)
+			continue;
+		if (center != nullptr && degree >= center->_elements.getSize())
+			continue;
+
+		bool passive = true;
+		for (Element* element : node->_elements)
+		{
+			if (!isPassive(element))
+			{
+				passive = false;
+				break;
+			}
+		}
+
+		if (passive)
+			center = node;
+	}
+
+	int degree = center != nullptr ? center->_elements.getSize() : 0;
+	if (center != nullptr && degree <= _maxStarMeshDegree && starToMesh(center))
+		return true;
+
+	// Otherwise try to turn a triangle into a star (mesh-star)
+	for (Element* element : _elements)
+	{
+		if (meshToStar(element))
+			return true;
+	}
+
+	// Only bigger stars are left, allow them from now on even though their mesh has degree * (degree - 1) / 2 elements
+	if (center == nullptr || !starToMesh(center))
+		return false;
+	_maxStarMeshDegree = degree;
+	return true;
+}
+
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::starToMesh(Node * center)
+{
+	// Copy, because removing the star elements changes the node's list
+	mf::LinkedList<Element*> star = center->_elements;
+
+	// Every neighbor should be reached through exactly one element
+	Scalar conductance = 0.0;
+	for (int i = 0; i < star.getSize(); ++i)
+	{
+		conductance += Scalar(1) / star[i]->_resistance;
+		for (int j = i + 1; j < star.getSize(); ++j)
+			if (otherNode(star[i], center) == otherNode(star[j], center))
+				return false;
+	}
+
+	StarMesh* starMesh = new StarMesh();
+	starMesh->_center = center;
+	MF_SOLVE_COUNT(starToMesh, 1);
+	MF_SOLVE_COUNT(allocations, 1 + star.getSize() * (star.getSize() - 1) / 2);
+
+	/*
+		Names only have to be unique, they come from the transform number and the nodes,
+		names of the star elements would double with every transform they take part in
+	*/
+	std::string prefix = "(star-mesh " + std::to_string(_starMeshes.getSize()) + ")";
+
+	// Mesh resistance between two neighbors: Rij = Ri * Rj * sum(1 / Rk)
+	for (int i = 0; i < star.getSize() - 1; ++i)
+	{
+		for (int j = i + 1; j < star.getSize(); ++j)
+		{
+			Element* el1 = star[i];
+			Element* el2 = star[j];
+			Node* neighbor1 = otherNode(el1, center);
+			Node* neighbor2 = otherNode(el2, center);
+			std::string name = prefix + neighbor1->getName() + "*" + neighbor2->getName();
+			Scalar resistance = el1->_resistance * el2->_resistance * conductance;
+
+			Element* mesh = addElement(name, 0, 0, resistance, neighbor1->getName(), neighbor2->getName());
+			mesh->_childrenConnections = STAR_MESH;
+			mesh->_starMesh = starMesh;
+			starMesh->_results.pushBack(mesh);
+		}
+	}
+
+	for (Element* element : star)
+	{
+		removeElement(element);
+		starMesh->_sources.pushBack(element);
+	}
+
+	_starMeshes.pushBack(starMesh);
+	return true;
+}
+
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::meshToStar(Element * element)
 {
+	if (!isPassive(element))
+		return false;
+
+	Node* nodeA = element->_node1;
+	Node* nodeB = element->_node2;
+
+	for (Element* elementA : nodeA->_elements)
+	{
+		if (elementA == element || !isPassive(elementA))
+			continue;
+
+		Node* nodeC = otherNode(elementA, nodeA);
+		if (nodeC == nodeB)
+			continue;
+
+		for (Element* elementB : nodeB->_elements)
+		{
+			if (elementB == element || !isPassive(elementB))
+				continue;
+			if (otherNode(elementB, nodeB) != nodeC)
+				continue;
+
+			/*
+				Only worth it when a corner of the triangle has a single
+				other element, because that corner becomes a series connection
+			*/
+			if (nodeA->_elements.getSize() != 3 && nodeB->_elements.getSize() != 3 && nodeC->_elements.getSize() != 3)
+				continue;
+
+			// elementA: A-C, elementB: B-C, element: A-B
+			Scalar sum = element->_resistance + elementA->_resistance + elementB->_resistance;
+			// Named like the mesh of star-mesh, so names stay short
+			std::string centerName = "(mesh-star " + std::to_string(_starMeshes.getSize()) + ")";
+
+			StarMesh* starMesh = new StarMesh();
+			starMesh->_center = searchOrCreateNode(centerName);
+			starMesh->_createdCenter = true;
+			// The record, the center and three elements
+			MF_SOLVE_COUNT(meshToStar, 1);
+			MF_SOLVE_COUNT(allocations, 5);
+
+			Element* star[3];
+			star[0] = addElement(centerName + "*" + nodeA->getName(), 0, 0, element->_resistance * elementA->_resistance / sum, nodeA->getName(), centerName);
+			star[1] = addElement(centerName + "*" + nodeB->getName(), 0, 0, element->_resistance * elementB->_resistance / sum, nodeB->getName(), centerName);
+			star[2] = addElement(centerName + "*" + nodeC->getName(), 0, 0, elementA->_resistance * elementB->_resistance / sum, nodeC->getName(), centerName);
+
+			for (Element* result : star)
+			{
+				result->_childrenConnections = STAR_MESH;
+				result->_starMesh = starMesh;
+				starMesh->_results.pushBack(result);
+			}
+
+			Element* delta[3] = { element, elementA, elementB };
+			for (Element* source : delta)
+			{
+				removeElement(source);
+				starMesh->_sources.pushBack(source);
+			}
+
+			_starMeshes.pushBack(starMesh);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::unmergeStarMesh(Element * element)
+{
+	StarMesh* starMesh = element->_starMesh;
+
+	// Wait until every element produced by the transform has its current
+	++starMesh->_resolved;
+	if (starMesh->_resolved < starMesh->_results.getSize())
+		return;
+
+	// Find node potentials, relative to the first node we meet
+	mf::LinkedList<Node*> known;
+	Element* first = starMesh->_results.getHead()->getData();
+	first->_node1->_potential = 0.0;
+	known.pushBack(first->_node1);
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (Element* result : starMesh->_results)
+		{
+			Scalar drop = result->_current * result->_resistance;
+			bool knows1 = known.find(result->_node1) != nullptr;
+			bool knows2 = known.find(result->_node2) != nullptr;
+
+			if (knows1 && !knows2)
+			{
+				result->_node2->_potential = result->_node1->_potential - drop;
+				known.pushBack(result->_node2);
+				changed = true;
+			}
+			else if (!knows1 && knows2)
+			{
+				result->_node1->_potential = result->_node2->_potential + drop;
+				known.pushBack(result->_node1);
+				changed = true;
+			}
+		}
+	}
+
+	// Star-mesh removed the center, so its potential comes from KCL
+	Node* center = starMesh->_center;
+	if (known.find(center) == nullptr)
+	{
+		Scalar weighted = 0.0;
+		Scalar conductance = 0.0;
+		for (Element* source : starMesh->_sources)
+		{
+			weighted += otherNode(source, center)->_potential / source->_resistance;
+			conductance += Scalar(1) / source->_resistance;
+		}
+		center->_potential = weighted / conductance;
+	}
+
+	// Every current first, unmerging a source can run another transform that reuses these potentials
+	for (Element* source : starMesh->_sources)
+		source->_current = (source->_node1->_potential - source->_node2->_potential) / source->_resistance;
+	for (Element* source : starMesh->_sources)
+		unmerge(source);
+
+	for (Element* result : starMesh->_results)
+		delete result;
+
+	// Remove the center we created for mesh-star, a star-mesh center is a node of the circuit
+	if (starMesh->_createdCenter && center->_elements.getSize() == 0)
+	{
+		MF_SOLVE_COUNT(listRemovals, 1);
+		_nodes.remove(center);
+		_nodesByName.erase(center->getName());
+		delete center;
+	}
+
+	_starMeshes.remove(starMesh);
+	delete starMesh;
+}
+
+template <typename Scalar>
+BasicNode<Scalar>* BasicCircuitCore<Scalar>::otherNode(Element * element, Node * node) const
+{
+	return element->_node1 == node ? element->_node2 : element->_node1;
+}
+
+template <typename Scalar>
+int BasicCircuitCore<Scalar>::connection(Element * el1, Element * el2) const
+{
+	MF_SOLVE_COUNT(connections, 1);
 	// If there are only 2 elements left in the circuit
 	// they are series and parallel at the same time
 	// but we have to consider them series in order to calculate the current
@@ -496,19 +1470,17 @@ int CircuitCore::connection(Element * el1, Element * el2) const
 	return NONE;
 }
 
-Node* CircuitCore::searchNode(std::string name) const
+template <typename Scalar>
+BasicNode<Scalar>* BasicCircuitCore<Scalar>::searchNode(const std::string& name) const
 {
-	for (Node* node : _nodes)
-	{
-		if (node->getName() == name)
-			return node;
-	}
-	return nullptr;
+	auto found = _nodesByName.find(name);
+	return found != _nodesByName.end() ? found->second : nullptr;
 }
 
-Node* CircuitCore::searchOrCreateNode(std::string name)
+template <typename Scalar>
+BasicNode<Scalar>* BasicCircuitCore<Scalar>::searchOrCreateNode(const std::string& name)
 {
-	Node* node = searchNode(name);
+	Node*& node = _nodesByName[name];
 
 	if (node == nullptr)
 	{
@@ -518,22 +1490,137 @@ Node* CircuitCore::searchOrCreateNode(std::string name)
 	return node;
 }
 
-bool CircuitCore::isBattery(Element * element) const
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::track(Element* element)
 {
-	if (element->_voltage > 0.00001 || element->_voltage < -0.00001)
+	element->_id = (int)_added.size();
+	element->_battery = isBattery(element);
+	_added.push_back(element);
+	_results.clear();
+	_nodeResults.clear();
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::untrack(Element* element)
+{
+	if (element->_id != -1)
+		_added[element->_id] = nullptr;
+	_results.clear();
+	_nodeResults.clear();
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::collectResults()
+{
+	_results.clear();
+	_results.reserve(_added.size());
+	for (Element* element : _added)
+		if (element != nullptr)
+			_results.push_back(ElementResult{ element->_id, element->_voltage, element->_current, element->_resistance });
+}
+
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::collectPotentials() const
+{
+	// solve() merges nodes joined by wires, so walk the added elements instead of the nodes left in the circuit
+	for (Node* node : _resultNodes)
+		node->_resultId = -1;
+	_resultNodes.clear();
+
+	std::vector<int> degrees;
+	for (Element* element : _added)
+	{
+		if (element == nullptr)
+			continue;
+		for (Node* node : { element->_node1, element->_node2 })
+		{
+			if (node->_resultId == -1)
+			{
+				node->_resultId = (int)_resultNodes.size();
+				_resultNodes.push_back(node);
+				degrees.push_back(0);
+			}
+			++degrees[node->_resultId];
+		}
+	}
+
+	// Elements at each node, node i owns [starts[i], starts[i + 1])
+	int count = (int)_resultNodes.size();
+	std::vector<int> starts(count + 1, 0);
+	for (int i = 0; i < count; ++i)
+		starts[i + 1] = starts[i] + degrees[i];
+
+	std::vector<Element*> incident(starts[count]);
+	std::vector<int> filled(starts.begin(), starts.end() - 1);
+	for (Element* element : _added)
+	{
+		if (element == nullptr)
+			continue;
+		incident[filled[element->_node1->_resultId]++] = element;
+		incident[filled[element->_node2->_resultId]++] = element;
+	}
+
+	// V1 - V2 = I * R - E along every element, starting from 0 volts in each connected part
+	std::vector<Scalar> potentials(count, Scalar(0));
+	std::vector<bool> known(count, false);
+	std::vector<int> queue;
+	for (int root = 0; root < count; ++root)
+	{
+		if (known[root])
+			continue;
+
+		known[root] = true;
+		queue.assign(1, root);
+		for (int k = 0; k < (int)queue.size(); ++k)
+		{
+			int i = queue[k];
+			for (int j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				Element* element = incident[j];
+				Scalar drop = element->_current * element->_resistance - (element->_battery ? element->_voltage : Scalar(0));
+				bool fromFirst = element->_node1->_resultId == i;
+				int other = fromFirst ? element->_node2->_resultId : element->_node1->_resultId;
+				if (known[other])
+					continue;
+
+				known[other] = true;
+				potentials[other] = fromFirst ? potentials[i] - drop : potentials[i] + drop;
+				queue.push_back(other);
+			}
+		}
+	}
+
+	_nodeResults.clear();
+	_nodeResults.reserve(count);
+	for (int i = 0; i < count; ++i)
+		_nodeResults.push_back(NodeResult{ i, potentials[i] });
+}
+
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::isBattery(Element * element) const
+{
+	if (ScalarTraits<Scalar>::magnitude(element->_voltage) > ScalarTraits<Scalar>::zero())
 		return true;
 
 	return false;
 }
 
-bool CircuitCore::isWire(Element* element) const
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::isPassive(Element* element) const
 {
-	if (!isBattery(element) && element->_resistance < 0.00001)
+	return !isBattery(element) && !isWire(element);
+}
+
+template <typename Scalar>
+bool BasicCircuitCore<Scalar>::isWire(Element* element) const
+{
+	if (!isBattery(element) && ScalarTraits<Scalar>::magnitude(element->_resistance) < ScalarTraits<Scalar>::zero())
 		return true;
 	return false;
 }
 
-void CircuitCore::printElements() const
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::printElements() const
 {
 	std::cout << std::endl;
 	std::cout << "------------------------" << std::endl;
@@ -546,12 +1633,13 @@ void CircuitCore::printElements() const
 		std::cout << "V: " << element->_voltage << " ";
 		std::cout << "I: " << element->_current << " ";
 		std::cout << "R: " << element->_resistance << " ";
-		std::cout << element->_node1->getName() << " " << element->_node2->getName() << std::endl;
+		std::cout << element->_node1->getName() << " " << element->_node2->getName() << "\n";
 	}
 	std::cout << std::endl;
 }
 
-void CircuitCore::printNodes() const 
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::printNodes() const 
 {
 	std::cout << std::endl;
 	std::cout << "------------------------" << std::endl;
@@ -569,7 +1657,8 @@ void CircuitCore::printNodes() const
 	std::cout << std::endl;
 }
 
-void CircuitCore::printConnections() const 
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::printConnections() const 
 {
 	std::cout << std::endl;
 	std::cout << "------------------------" << std::endl;
@@ -589,3 +1678,40 @@ void CircuitCore::printConnections() const
 	}
 }
 
+template <typename Scalar>
+void BasicCircuitCore<Scalar>::benchmarkOrderings() const
+{
+	std::cout << std::endl;
+	std::cout << "------------------------" << std::endl;
+	std::cout << "------ Orderings -------" << std::endl;
+	std::cout << "------------------------" << std::endl;
+
+	BasicNodalSystem<Scalar> system(*this);
+	system.benchmark(std::cout);
+
+	std::cout << std::endl;
+}
+
+template class BasicNode<float>;
+template class BasicNode<double>;
+template class BasicNode<long double>;
+template class BasicNode<std::complex<double>>;
+
+template class BasicElement<float>;
+template class BasicElement<double>;
+template class BasicElement<long double>;
+template class BasicElement<std::complex<double>>;
+
+template class BasicCircuitCore<float>;
+template class BasicCircuitCore<double>;
+template class BasicCircuitCore<long double>;
+template class BasicCircuitCore<std::complex<double>>;
+
+// The code generator only records solve()
+template BasicCircuitCore<TracedScalar>::BasicCircuitCore();
+template BasicCircuitCore<TracedScalar>::~BasicCircuitCore();
+template BasicElement<TracedScalar>* BasicCircuitCore<TracedScalar>::addWire(std::string, std::string, std::string);
+template BasicElement<TracedScalar>* BasicCircuitCore<TracedScalar>::addResistor(std::string, TracedScalar, std::string, std::string);
+template BasicElement<TracedScalar>* BasicCircuitCore<TracedScalar>::addBattery(std::string, TracedScalar, std::string, std::string);
+template void BasicCircuitCore<TracedScalar>::solve();
+template class BasicElement<TracedScalar>;
@@ -1,52 +1,187 @@
 #ifndef MF_CIRCUIT_DEF
 #define MF_CIRCUIT_DEF
 
+#include <complex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "mfLinkedList.h"
+#include "mfUnrolledList.h"
+#include "CircuitScalar.h"
 
-class Node;
-class Element;
-class CircuitCore;
+/*
+	Everything in the core is a template on the type of voltages, currents and resistances (Scalar).
+	It's compiled for float, double, long double and std::complex<double> (AC, where resistances are impedances).
+	CircuitCore, Element, Node, ... are the double versions.
+*/
+template <typename Scalar> class BasicNode;
+template <typename Scalar> class BasicElement;
+template <typename Scalar> class BasicStarMesh;
+template <typename Scalar> class BasicPortModel;
+template <typename Scalar> class BasicNodalSystem;
+template <typename Scalar> class BasicSubcircuit;
+template <typename Scalar> class BasicCircuitCore;
+template <typename Scalar> class BasicCircuitBinary;
+template <typename Scalar> class BasicCircuitCache;
+class Ordering;
 
-class Node
+typedef BasicNode<double> Node;
+typedef BasicElement<double> Element;
+typedef BasicPortModel<double> PortModel;
+typedef BasicNodalSystem<double> NodalSystem;
+typedef BasicSubcircuit<double> Subcircuit;
+typedef BasicCircuitCore<double> CircuitCore;
+
+template <typename Scalar> struct BasicElementResult;
+template <typename Scalar> struct BasicNodeResult;
+template <typename Scalar, typename Result = BasicElementResult<Scalar>> class BasicResultView;
+typedef BasicElementResult<double> ElementResult;
+typedef BasicNodeResult<double> NodeResult;
+typedef BasicResultView<double> ResultView;
+typedef BasicResultView<double, NodeResult> NodeResultView;
+
+template <typename Scalar>
+class BasicNode
 {
-	friend class CircuitCore;
+	template <typename> friend class BasicCircuitCore;
+	template <typename> friend class BasicNodalSystem;
+	template <typename> friend class BasicCircuitBinary;
+	template <typename> friend class BasicCircuitCache;
+	typedef BasicElement<Scalar> Element;
 private:
-	Node();
-	Node(std::string name);
+	BasicNode();
+	BasicNode(std::string name);
 	std::string getName() const;
 
 private:
 	std::string _name;
 	mf::LinkedList<Element*> _elements;
+	Scalar _potential = Scalar(0);
+	int _resultId = -1;
 };
 
-class Element
+template <typename Scalar>
+class BasicElement
 {
-	friend class CircuitCore;
+	template <typename> friend class BasicCircuitCore;
+	template <typename> friend class BasicNodalSystem;
+	template <typename> friend class BasicCircuitBinary;
+	template <typename> friend class BasicCircuitCache;
+	typedef BasicNode<Scalar> Node;
+	typedef BasicElement<Scalar> Element;
 public:
 	std::string getName() const;
-	double getVoltage() const;
-	double getResistance() const;
-	double getCurrent() const;
+	Scalar getVoltage() const;
+	Scalar getResistance() const;
+	Scalar getCurrent() const;
 
 private:
-	Element();
-	Element(std::string name, double voltage, double current, double resistance	, Node* node1, Node* node2);
+	BasicElement();
+	BasicElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, Node* node1, Node* node2);
 
 private:
 	std::string _name;
-	double _voltage = 0.0;
-	double _current = 0.0;
-	double _resistance = 0.0;
+	Scalar _voltage = Scalar(0);
+	Scalar _current = Scalar(0);
+	Scalar _resistance = Scalar(0);
 	Node* _node1 = nullptr;
 	Node* _node2 = nullptr;
 	Element* _left = nullptr;
 	Element* _right = nullptr;
+	int _leftDirection = 1;
+	int _rightDirection = 1;
 	int _childrenConnections = 0;
+	BasicStarMesh<Scalar>* _starMesh = nullptr;
+	int _id = -1;
+	// Whether it was a battery when added, solving overwrites the voltage of the others with I * R
+	bool _battery = false;
+	// Where the element sits in the circuit's list and in its nodes' lists, to unlink it in O(1)
+	typename mf::UnrolledList<Element*>::Iterator _inCircuit;
+	mf::ListNode<Element*>* _inNode1 = nullptr;
+	mf::ListNode<Element*>* _inNode2 = nullptr;
+	// Part of a block allocated by the circuit (see allocateElements), freed with the block
+	bool _pooled = false;
+};
+
+// Records a star-mesh (or mesh-star) transform, so unmerge can map
+// the currents of the produced elements back to the replaced ones
+template <typename Scalar>
+class BasicStarMesh
+{
+	template <typename> friend class BasicCircuitCore;
+private:
+	BasicNode<Scalar>* _center = nullptr;
+	// The center is a node mesh-star made up, not one of the circuit
+	bool _createdCenter = false;
+	mf::LinkedList<BasicElement<Scalar>*> _sources;
+	mf::LinkedList<BasicElement<Scalar>*> _results;
+	int _resolved = 0;
+};
+
+/*
+	Behaviour of a network seen from a few of its nodes (ports):
+	I = Y * V - J
+	I is the current flowing into the network at each port and V is the potential of each port.
+	It doesn't depend on the circuit it came from, so it can be kept and attached to other circuits
+*/
+template <typename Scalar>
+class BasicPortModel
+{
+	template <typename> friend class BasicNodalSystem;
+	template <typename> friend class BasicCircuitCore;
+public:
+	int getPortCount() const;
+	std::string getPortName(int port) const;
+	Scalar getAdmittance(int row, int column) const;
+	Scalar getSourceCurrent(int port) const;
+	Scalar getTheveninVoltage() const;
+	Scalar getTheveninResistance() const;
+	Scalar getNortonCurrent() const;
+
+private:
+	std::vector<std::string> _ports;
+	std::vector<Scalar> _admittance;
+	std::vector<Scalar> _sources;
+};
+
+// What solving gave an element, nameId is the order it was added in (see BasicCircuitCore::getResultName)
+template <typename Scalar>
+struct BasicElementResult
+{
+	int nameId;
+	Scalar voltage;
+	Scalar current;
+	Scalar resistance;
 };
 
-class CircuitCore
+// Potential of a node after solving, nameId is the order it was first used in (see BasicCircuitCore::getNodeResultName)
+template <typename Scalar>
+struct BasicNodeResult
+{
+	int nameId;
+	Scalar potential;
+};
+
+// Read-only range over results stored by the circuit, nothing is copied
+template <typename Scalar, typename Result>
+class BasicResultView
+{
+public:
+	BasicResultView(const Result* data, int size) : _data(data), _size(size) { }
+
+	const Result* begin() const { return _data; }
+	const Result* end() const { return _data + _size; }
+	int size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	const Result& operator [] (int index) const { return _data[index]; }
+
+private:
+	const Result* _data = nullptr;
+	int _size = 0;
+};
+
+// Enums shared by every BasicCircuitCore, so one catch handles errors of all of them
+class CircuitBase
 {
 public:
 
@@ -55,6 +190,13 @@ public:
 		NONE,
 		SERIES,
 		PARALLEL,
+		STAR_MESH,
+	};
+
+	enum Precision
+	{
+		FULL_PRECISION,
+		MIXED_PRECISION,
 	};
 
 	enum Errors
@@ -72,47 +214,228 @@ public:
 		MERGE_FAILED,
 		UNMERGE_FAILED,
 		TWO_SAME_NODES,
+		NO_NODE,
+		PORT_COUNT_MISMATCH,
+		NETLIST_CANNOT_OPEN,
+		NETLIST_SYNTAX,
+		NETLIST_UNSUPPORTED,
+		NETLIST_UNKNOWN_SUBCIRCUIT,
+		BINARY_INVALID,
+	};
+
+	// What the try functions return instead of throwing, with the element and node the error is about (if any)
+	struct Outcome
+	{
+		bool ok = true;
+		Errors error = NO_ELEMENT;
+		std::string element;
+		std::string node;
+
+		explicit operator bool() const { return ok; }
+
+		static Outcome failure(Errors error, const std::string& element = "", const std::string& node = "")
+		{
+			Outcome status;
+			status.ok = false;
+			status.error = error;
+			status.element = element;
+			status.node = node;
+			return status;
+		}
+	};
+
+	/*
+		What the last solve() did and how long each phase took, the phase it failed in counts up to the failure.
+		Only filled when CircuitCore.cpp is built with -DMF_SOLVE_STATS, otherwise everything stays 0
+		and the counting isn't compiled in at all
+	*/
+	struct SolveStats
+	{
+		// Seconds
+		double validate = 0.0;
+		double wireRemoval = 0.0;
+		double reduction = 0.0;
+		double unmerge = 0.0;
+
+		long long wiresRemoved = 0;
+		// Calls of connection(), the pair test of the reduction loop
+		long long connections = 0;
+		long long seriesMerges = 0;
+		long long parallelMerges = 0;
+		long long starToMesh = 0;
+		long long meshToStar = 0;
+		// Deepest nesting of unmerge(), the height of the merge tree
+		int unmergeDepth = 0;
+		// Elements, nodes and star-mesh records created while solving
+		long long allocations = 0;
+		// Entries taken out of the element lists of the circuit and its nodes, and nodes out of the circuit
+		long long listRemovals = 0;
+	};
+
+	/*
+		Heap bytes a circuit holds, counted from the sizes of its objects (allocator overhead isn't).
+		The parts add up to current, as of the last measurement. peak is the largest measurement so far,
+		and each phase gets the largest of its start and its end in the last solve()
+	*/
+	struct MemoryStats
+	{
+		size_t current = 0;
+		size_t peak = 0;
+
+		// Element objects and their names, merged and transformed ones too
+		size_t elements = 0;
+		size_t nodes = 0;
+		// Entries of the element and node lists (kept for reuse ones too), star-mesh records
+		size_t lists = 0;
+		// Name lookup tables
+		size_t lookup = 0;
+		size_t results = 0;
+
+		size_t validate = 0;
+		size_t wireRemoval = 0;
+		size_t reduction = 0;
+		size_t unmerge = 0;
+		// solveNodal(), the circuit with the nodal equations and their factorization
+		size_t nodal = 0;
 	};
+};
+
+template <typename Scalar>
+class BasicCircuitCore : public CircuitBase
+{
+	template <typename> friend class BasicNodalSystem;
+	template <typename> friend class BasicCircuitBinary;
+	template <typename> friend class BasicCircuitCache;
+	typedef BasicNode<Scalar> Node;
+	typedef BasicElement<Scalar> Element;
+	typedef BasicStarMesh<Scalar> StarMesh;
+	typedef BasicPortModel<Scalar> PortModel;
+	typedef BasicSubcircuit<Scalar> Subcircuit;
+	typedef BasicElementResult<Scalar> ElementResult;
+	typedef BasicNodeResult<Scalar> NodeResult;
+	typedef BasicResultView<Scalar> ResultView;
+	typedef BasicResultView<Scalar, NodeResult> NodeResultView;
+	typedef typename ScalarTraits<Scalar>::Real Real;
 
 public:
-	CircuitCore();
-	~CircuitCore();
+	BasicCircuitCore();
+	~BasicCircuitCore();
 
 	Element* addWire(std::string name, std::string negativeSide, std::string positiveSide);
-	Element* addResistor(std::string name, double resistance, std::string negativeSide, std::string positiveSide);
-	Element* addBattery(std::string name, double voltage, std::string negativeSide, std::string positiveSide);
+	Element* addResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide);
+	Element* addBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide);
+	// The removed element belongs to the caller, who deletes it (tryRemoveElement frees it instead)
 	Element* removeElement(std::string name);
-	Element* searchElement(std::string name) const;
+	// Voltage of a battery or resistance of anything else, before solving
+	void setValue(std::string name, Scalar value);
+	Element* searchElement(const std::string& name) const;
 	mf::LinkedList<Element*> getElementsList() const;
+	PortModel reducePorts(const mf::LinkedList<std::string>& ports) const;
+	void addPortModel(std::string name, const PortModel& model, const mf::LinkedList<std::string>& nodes);
+	void addSubcircuit(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes);
 	void solve();
+	void solveNodal(const Ordering* ordering = nullptr, Precision precision = FULL_PRECISION);
 	bool dirty() const;
+	const SolveStats& getSolveStats() const;
+	/*
+		Measures the circuit now, which walks all of it. With trackMemory on, solve() also measures
+		where it switches phases (a few walks per solve). Don't call it from two threads at once
+	*/
+	MemoryStats getMemoryStats() const;
+	void trackMemory(bool track);
+	// Makes room for this many elements and nodes at once, before adding a lot of them
+	void reserve(int elements, int nodes);
+
+	/*
+		Results of the last solve, one record per element in the order they were added.
+		They live inside the circuit, so they are valid until it changes.
+		copyResults fills caller-owned arrays (any of them can be null) and returns how many it wrote
+	*/
+	ResultView getResults() const;
+	const std::string& getResultName(int nameId) const;
+	int copyResults(Scalar* voltages, Scalar* currents, Scalar* resistances, int capacity) const;
+
+	/*
+		Node potentials of the last solve, one record per node of the added elements in the order they were first used.
+		They come from the voltage drops of the elements, the first node of each connected part is at 0 volts.
+		They are computed by the first call, so don't make it from two threads at once
+	*/
+	NodeResultView getNodeResults() const;
+	const std::string& getNodeResultName(int nameId) const;
+
+	// Same as above, but failures are returned instead of thrown, which is much cheaper when many circuits fail
+	Outcome tryAddWire(std::string name, std::string negativeSide, std::string positiveSide, Element** added = nullptr);
+	Outcome tryAddResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide, Element** added = nullptr);
+	Outcome tryAddBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide, Element** added = nullptr);
+	Outcome tryRemoveElement(std::string name);
+	Outcome trySetValue(std::string name, Scalar value);
+	Outcome tryReducePorts(const mf::LinkedList<std::string>& ports, PortModel& model) const;
+	Outcome tryAddPortModel(std::string name, const PortModel& model, const mf::LinkedList<std::string>& nodes);
+	Outcome tryAddSubcircuit(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes);
+	Outcome trySolve();
+	Outcome trySolveNodal(const Ordering* ordering = nullptr, Precision precision = FULL_PRECISION);
 
 public:
 	void printElements() const;
 	void printNodes() const;
 	void printConnections() const;
+	void benchmarkOrderings() const;
 
 private:
-	Element* addElement(std::string name, double voltage, double current, double resistance, std::string negativeSide, std::string positiveSide);
+	Element* addElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, std::string negativeSide, std::string positiveSide);
+	Outcome tryAddElement(std::string name, Scalar voltage, Scalar current, Scalar resistance, std::string negativeSide, std::string positiveSide, Element** added);
 	Element* addElement(Element* element);
+	Element* allocateElements(int count);
+	Outcome tryAttach(Element* element);
 	Element* removeElement(Element* element);
-	Node* searchOrCreateNode(std::string name);
-	Element* merge(Element* el1, Element* el2);
-	void removeAndBindElement(Element* element);
+	void unlink(Element* element);
+	Node* searchOrCreateNode(const std::string& name);
+	void track(Element* element);
+	void untrack(Element* element);
+	void collectResults();
+	void collectPotentials() const;
+	Outcome merge(Element* el1, Element* el2);
+	Outcome removeAndBindElement(Element* element);
 	void unmerge(Element* element);
+	bool transform();
+	bool starToMesh(Node* center);
+	bool meshToStar(Element* element);
+	void unmergeStarMesh(Element* element);
+	Node* otherNode(Element* element, Node* node) const;
+	bool isPassive(Element* element) const;
 
-	void validate() const;
+	Outcome validate() const;
+	void measureMemory() const;
+	void switchMemoryPhase(size_t* leaving, size_t* entering);
 	bool isBattery(Element* element) const;
 	bool isWire(Element* element) const;
 	int connection(Element* el1, Element* el2) const;
-	Node* searchNode(std::string name) const;
+	Node* searchNode(const std::string& name) const;
 
 private:
 	bool isDirty = false;
-	mf::LinkedList<Element*> _elements;
+	// Indexed in nested loops while solving
+	mf::UnrolledList<Element*> _elements;
 	mf::LinkedList<Node*> _nodes;
-};
-
+	// The same elements and nodes by name
+	std::unordered_map<std::string, Element*> _elementsByName;
+	std::unordered_map<std::string, Node*> _nodesByName;
+	mf::LinkedList<StarMesh*> _starMeshes;
+	// Star-mesh prefers nodes up to this degree, raised while solving once only bigger ones are left
+	static const int defaultStarMeshDegree = 4;
+	int _maxStarMeshDegree = defaultStarMeshDegree;
+	// Counted in const helpers like connection() too
+	mutable SolveStats _solveStats;
+	bool _trackMemory = false;
+	mutable MemoryStats _memoryStats;
 
+	// Elements added by the user, by id, and what solving gave them
+	std::vector<Element*> _added;
+	std::vector<ElementResult> _results;
+	mutable std::vector<Node*> _resultNodes;
+	mutable std::vector<NodeResult> _nodeResults;
+	// Elements allocated together, like the ones of a loaded binary circuit
+	std::vector<Element*> _elementBlocks;
+};
 
 #endif // MF_CIRCUIT_DEF
\ No newline at end of file
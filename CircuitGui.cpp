@@ -1,5 +1,6 @@
 #define OLC_PGE_APPLICATION
 #include "CircuitGui.h"
+#include "CircuitTrace.h"
 #include <math.h>
 
 class Dot;
@@ -130,6 +131,7 @@ bool CircuitGui::OnUserCreate()
 
 bool CircuitGui::OnUserUpdate(float fTimeElapsed)
 {
+	TraceSpan span("OnUserUpdate");
 	if (IsFocused()){
 		checkKeyEvent();
 		checkMouseEvent();
@@ -214,6 +216,7 @@ void CircuitGui::checkKeyEvent()
 	if (GetKey(olc::Key::R).bPressed) selectResistor();
 	if (GetKey(olc::Key::V).bPressed) selectVoltageSource();
 	if (GetKey(olc::Key::B).bPressed) selectBlank();
+	if (GetKey(olc::Key::T).bPressed) toggleTrace();
 	if (GetKey(olc::Key::ESCAPE).bPressed){
 		drawField();
 
@@ -228,6 +231,7 @@ void CircuitGui::checkKeyEvent()
 
 void CircuitGui::checkMouseEvent()
 {
+	TraceSpan span("checkMouseEvent");
 	if (_editDialogOpen){
 
 		int okX = ScreenWidth() / 2 - 150 + 300 - 98;
@@ -369,45 +373,54 @@ void CircuitGui::selectBlank()
 */
 void CircuitGui::createAndSolveCircuit()
 {
+	TraceSpan span("createAndSolveCircuit");
 	if (_circuitCore != nullptr) delete _circuitCore;
 
 	_circuitCore = new CircuitCore();
 
 	for (Item& item : _itemsList)
 	{
-		try
+		CircuitCore::Outcome status;
+		switch (item._type)
 		{
-			switch (item._type)
-			{
-			case WIRE:
-				_circuitCore->addWire(item._name, item._fDot->getName(), item._sDot->getName());
-				break;
-			case RESISTOR:
-				_circuitCore->addResistor(item._name, std::stod(item._resistance), item._fDot->getName(), item._sDot->getName());
-				break;
-			case VOLTAGE:
-				_circuitCore->addBattery(item._name, std::stod(item._voltage), item._fDot->getName(), item._sDot->getName());
-				break;
-			}
-		}
-		catch (CircuitCore::Errors error)
-		{
-			_error = error;
+		case WIRE:
+			status = _circuitCore->tryAddWire(item._name, item._fDot->getName(), item._sDot->getName());
+			break;
+		case RESISTOR:
+			status = _circuitCore->tryAddResistor(item._name, std::stod(item._resistance), item._fDot->getName(), item._sDot->getName());
+			break;
+		case VOLTAGE:
+			status = _circuitCore->tryAddBattery(item._name, std::stod(item._voltage), item._fDot->getName(), item._sDot->getName());
+			break;
 		}
-	}
 
-	try
-	{
-		_circuitCore->solve();
+		if (!status)
+			_error = status.error;
 	}
-	catch (CircuitCore::Errors error)
+
+	CircuitCore::Outcome status = _circuitCore->trySolve();
+	if (!status)
 	{
 		delete _circuitCore;
 		_circuitCore = nullptr;
-		_error = error;
+		_error = status.error;
 	}
 }
 
+// The first press starts tracing the session, the next one writes it to CircuitTrace.json in the working directory
+void CircuitGui::toggleTrace()
+{
+	if (!CircuitTrace::enabled())
+	{
+		CircuitTrace::clear();
+		CircuitTrace::start();
+		return;
+	}
+
+	CircuitTrace::stop();
+	CircuitTrace::save("CircuitTrace.json");
+}
+
 void CircuitGui::addItem(int type, Dot * firstDot, Dot * secondDot, olc::Pixel color)
 {
 	Item* foundItem = _itemsList.find(Item(type, firstDot, secondDot));
@@ -702,6 +715,7 @@ void CircuitGui::drawItemEditDialog(Item * item)
 
 void CircuitGui::drawAllItems()
 {
+	TraceSpan span("drawAllItems");
 	if (_editDialogOpen) return;
 
 	// Clear element info in toolbar
@@ -94,6 +94,7 @@ private:
 
 private:
 	void createAndSolveCircuit();
+	void toggleTrace();
 	void addItem(int type, Dot* firstDot, Dot* secondDot, olc::Pixel color = olc::BLACK);
 	void updateItem(Item* item);
 	Dot* getNearDot(int x, int y);
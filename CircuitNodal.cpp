@@ -0,0 +1,814 @@
+#include "CircuitNodal.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+template <typename Item>
+static std::size_t vectorBytes(const std::vector<Item>& items)
+{
+	return items.capacity() * sizeof(Item);
+}
+
+static std::size_t vectorBytes(const std::vector<bool>& items)
+{
+	return items.capacity() / 8;
+}
+
+static std::size_t graphBytes(const std::vector<std::vector<int>>& graph)
+{
+	std::size_t bytes = vectorBytes(graph);
+	for (const std::vector<int>& neighbors : graph)
+		bytes += vectorBytes(neighbors);
+	return bytes;
+}
+
+// A tree node of std::map is the entry, three links and the color
+template <typename Scalar>
+static std::size_t rowsBytes(const std::vector<std::map<int, Scalar>>& rows)
+{
+	std::size_t bytes = vectorBytes(rows);
+	for (const std::map<int, Scalar>& row : rows)
+		bytes += row.size() * (sizeof(std::pair<const int, Scalar>) + 4 * sizeof(void*));
+	return bytes;
+}
+
+/*
+================= Public realization of class BasicPortModel =================
+*/
+
+template <typename Scalar>
+int BasicPortModel<Scalar>::getPortCount() const { return (int)_ports.size(); }
+
+template <typename Scalar>
+std::string BasicPortModel<Scalar>::getPortName(int port) const { return _ports[port]; }
+
+template <typename Scalar>
+Scalar BasicPortModel<Scalar>::getAdmittance(int row, int column) const { return _admittance[row * _ports.size() + column]; }
+
+template <typename Scalar>
+Scalar BasicPortModel<Scalar>::getSourceCurrent(int port) const { return _sources[port]; }
+
+template <typename Scalar>
+Scalar BasicPortModel<Scalar>::getTheveninVoltage() const
+{
+	// Open circuit: Y * V = J, the first port is the negative side
+	return getNortonCurrent() * getTheveninResistance();
+}
+
+template <typename Scalar>
+Scalar BasicPortModel<Scalar>::getTheveninResistance() const
+{
+	if (_ports.size() != 2)
+		throw CircuitBase::PORT_COUNT_MISMATCH;
+
+	Scalar conductance = getAdmittance(1, 1);
+	if (std::abs(conductance) < ScalarTraits<Scalar>::shortCircuit())
+		throw CircuitBase::NOT_CONNECTED;
+
+	return Scalar(1) / conductance;
+}
+
+template <typename Scalar>
+Scalar BasicPortModel<Scalar>::getNortonCurrent() const
+{
+	if (_ports.size() != 2)
+		throw CircuitBase::PORT_COUNT_MISMATCH;
+
+	return _sources[1];
+}
+
+/*
+================= Public realization of class LdlFactorization =================
+*/
+
+template <typename Scalar, typename Factor>
+LdlFactorization<Scalar, Factor>::LdlFactorization(const std::vector<std::map<int, Scalar>>& matrix, const std::vector<int>& order) : _order(order)
+{
+	int size = (int)matrix.size();
+	_positions.resize(size);
+	for (int i = 0; i < size; ++i)
+		_positions[_order[i]] = i;
+
+	// Symbolic: elimination tree and the number of nonzeros of each column of L
+	std::vector<int> parents(size, -1);
+	std::vector<int> flags(size, -1);
+	std::vector<int> counts(size, 0);
+
+	for (int k = 0; k < size; ++k)
+	{
+		flags[k] = k;
+		for (auto& entry : matrix[_order[k]])
+		{
+			for (int i = _positions[entry.first]; i < k && flags[i] != k; i = parents[i])
+			{
+				if (parents[i] == -1)
+					parents[i] = k;
+				++counts[i];
+				flags[i] = k;
+			}
+		}
+	}
+
+	_columnStarts.assign(size + 1, 0);
+	for (int i = 0; i < size; ++i)
+		_columnStarts[i + 1] = _columnStarts[i] + counts[i];
+
+	_rows.resize(_columnStarts[size]);
+	_values.resize(_columnStarts[size]);
+	_diagonal.assign(size, Factor(0));
+
+	// Numeric: compute L one row at a time (up-looking)
+	std::vector<Factor> work(size, Factor(0));
+	std::vector<int> pattern(size);
+	std::vector<int> lengths(size, 0);
+	flags.assign(size, -1);
+
+	for (int k = 0; k < size; ++k)
+	{
+		// Nonzeros of row k of L in topological order, stacked from the end of pattern
+		int top = size;
+		flags[k] = k;
+		for (auto& entry : matrix[_order[k]])
+		{
+			int i = _positions[entry.first];
+			if (i > k)
+				continue;
+
+			work[i] += (Factor)entry.second;
+
+			int length = 0;
+			for (; flags[i] != k; i = parents[i])
+			{
+				pattern[length++] = i;
+				flags[i] = k;
+			}
+			while (length > 0)
+				pattern[--top] = pattern[--length];
+		}
+
+		_diagonal[k] = work[k];
+		work[k] = Factor(0);
+
+		for (; top < size; ++top)
+		{
+			int i = pattern[top];
+			Factor value = work[i];
+			work[i] = Factor(0);
+
+			int end = _columnStarts[i] + lengths[i];
+			for (int p = _columnStarts[i]; p < end; ++p)
+				work[_rows[p]] -= _values[p] * value;
+
+			Factor factor = value / _diagonal[i];
+			_diagonal[k] -= factor * value;
+			_rows[end] = k;
+			_values[end] = factor;
+			++lengths[i];
+		}
+
+		// A grounded circuit with positive resistances only gets here when Factor overflows or underflows
+		if (!(std::abs(_diagonal[k]) >= std::numeric_limits<typename ScalarTraits<Factor>::Real>::min()) || !ScalarTraits<Factor>::finite(_diagonal[k]))
+		{
+			_failedRow = _order[k];
+			return;
+		}
+	}
+}
+
+template <typename Scalar, typename Factor>
+void LdlFactorization<Scalar, Factor>::solve(std::vector<Scalar>& values) const
+{
+	int size = (int)_order.size();
+	std::vector<Scalar> work(size);
+	for (int i = 0; i < size; ++i)
+		work[i] = values[_order[i]];
+
+	for (int j = 0; j < size; ++j)
+		for (int p = _columnStarts[j]; p < _columnStarts[j + 1]; ++p)
+			work[_rows[p]] -= Scalar(_values[p]) * work[j];
+
+	for (int j = 0; j < size; ++j)
+		work[j] /= Scalar(_diagonal[j]);
+
+	for (int j = size - 1; j >= 0; --j)
+		for (int p = _columnStarts[j]; p < _columnStarts[j + 1]; ++p)
+			work[j] -= Scalar(_values[p]) * work[_rows[p]];
+
+	for (int i = 0; i < size; ++i)
+		values[_order[i]] = work[i];
+}
+
+template <typename Scalar, typename Factor>
+int LdlFactorization<Scalar, Factor>::getFailedRow() const
+{
+	return _failedRow;
+}
+
+template <typename Scalar, typename Factor>
+long long LdlFactorization<Scalar, Factor>::getFill() const
+{
+	return _columnStarts.empty() ? 0 : _columnStarts.back();
+}
+
+template <typename Scalar, typename Factor>
+std::size_t LdlFactorization<Scalar, Factor>::getBytes() const
+{
+	return vectorBytes(_order) + vectorBytes(_positions) + vectorBytes(_columnStarts) + vectorBytes(_rows) + vectorBytes(_values) + vectorBytes(_diagonal);
+}
+
+/*
+================= Public realization of class BasicNodalSystem =================
+*/
+
+template <typename Scalar>
+BasicNodalSystem<Scalar>::BasicNodalSystem(const BasicCircuitCore<Scalar>& circuit)
+{
+	for (Node* node : circuit._nodes)
+	{
+		_indices[node] = (int)_parents.size();
+		_nodes.push_back(node);
+		_parents.push_back((int)_parents.size());
+		_offsets.push_back(0.0);
+	}
+
+	// Glue nodes of wires and ideal batteries together
+	for (Element* element : circuit._elements)
+	{
+		if (std::abs(element->_resistance) > ScalarTraits<Scalar>::shortCircuit())
+			continue;
+
+		bool battery = circuit.isBattery(element);
+		_links.push_back(element);
+		_treeLinks.push_back(bind(_indices.at(element->_node1), _indices.at(element->_node2), battery ? element->_voltage : Scalar(0), battery));
+		if (!_outcome)
+		{
+			_outcome.element = element->getName();
+			return;
+		}
+	}
+
+	// Number the supernodes
+	std::vector<int> numbers(_parents.size(), -1);
+	_supernodes.resize(_parents.size());
+	for (int i = 0; i < (int)_parents.size(); ++i)
+	{
+		int root = find(i);
+		if (numbers[root] == -1)
+		{
+			numbers[root] = (int)_rows.size();
+			_rows.emplace_back();
+		}
+		_supernodes[i] = numbers[root];
+	}
+	_sources.assign(_rows.size(), 0.0);
+
+	/*
+		Resistors and batteries with resistance, the current leaving node1 is
+		G * (V1 - V2) + G * E, and V1 = Vsupernode + offset
+	*/
+	for (Element* element : circuit._elements)
+	{
+		if (std::abs(element->_resistance) <= ScalarTraits<Scalar>::shortCircuit())
+			continue;
+
+		_branches.push_back(element);
+		int node1 = _indices.at(element->_node1);
+		int node2 = _indices.at(element->_node2);
+		Scalar conductance = Scalar(1) / element->_resistance;
+		Scalar current = conductance * (_offsets[node1] - _offsets[node2] + element->_voltage);
+
+		stamp(_supernodes[node1], _supernodes[node2], conductance, current);
+	}
+}
+
+template <typename Scalar>
+const CircuitBase::Outcome& BasicNodalSystem<Scalar>::getOutcome() const
+{
+	return _outcome;
+}
+
+template <typename Scalar>
+int BasicNodalSystem<Scalar>::getSize() const
+{
+	return (int)_rows.size();
+}
+
+template <typename Scalar>
+int BasicNodalSystem<Scalar>::getSupernode(Node* node) const
+{
+	return _supernodes[_indices.at(node)];
+}
+
+template <typename Scalar>
+Scalar BasicNodalSystem<Scalar>::getOffset(Node* node) const
+{
+	return _offsets[_indices.at(node)];
+}
+
+template <typename Scalar>
+std::size_t BasicNodalSystem<Scalar>::getBytes() const
+{
+	// An unordered_map entry is the key and value, the next link and the cached hash
+	std::size_t bytes = _indices.bucket_count() * sizeof(void*) + _indices.size() * (sizeof(std::pair<Node* const, int>) + 2 * sizeof(void*));
+	bytes += vectorBytes(_nodes) + vectorBytes(_branches) + vectorBytes(_links) + vectorBytes(_treeLinks);
+	bytes += vectorBytes(_parents) + vectorBytes(_offsets) + vectorBytes(_supernodes) + rowsBytes(_rows) + vectorBytes(_sources);
+	return bytes;
+}
+
+template <typename Scalar>
+std::size_t BasicNodalSystem<Scalar>::getSolveBytes() const
+{
+	return _solveBytes;
+}
+
+template <typename Scalar>
+std::vector<std::vector<int>> BasicNodalSystem<Scalar>::getGraph() const
+{
+	std::vector<std::vector<int>> graph(_rows.size());
+	for (int i = 0; i < (int)_rows.size(); ++i)
+		for (auto& entry : _rows[i])
+			if (entry.first != i)
+				graph[i].push_back(entry.first);
+
+	return graph;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNodalSystem<Scalar>::reduce(const mf::LinkedList<Node*>& ports, PortModel& model) const
+{
+	model = PortModel();
+	std::vector<int> portRows;
+	std::vector<bool> isPort(_rows.size(), false);
+
+	for (Node* port : ports)
+	{
+		int row = getSupernode(port);
+
+		// Two ports tied together by wires or batteries have no finite admittance
+		if (isPort[row])
+			return CircuitBase::Outcome::failure(CircuitBase::SHORT_CIRCUIT, "", port->getName());
+
+		isPort[row] = true;
+		portRows.push_back(row);
+		model._ports.push_back(port->getName());
+	}
+
+	std::vector<std::map<int, Scalar>> rows = _rows;
+	std::vector<Scalar> sources = _sources;
+
+	// Kron reduction, eliminate the internal node with the fewest neighbors first
+	typedef std::pair<int, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	for (int i = 0; i < (int)rows.size(); ++i)
+		if (!isPort[i])
+			queue.push(Entry((int)rows[i].size(), i));
+
+	std::vector<bool> eliminated(rows.size(), false);
+	while (!queue.empty())
+	{
+		Entry entry = queue.top();
+		queue.pop();
+
+		int pivot = entry.second;
+		if (eliminated[pivot] || entry.first != (int)rows[pivot].size())
+			continue;
+
+		std::vector<int> neighbors;
+		for (auto& neighbor : rows[pivot])
+			if (neighbor.first != pivot && !isPort[neighbor.first])
+				neighbors.push_back(neighbor.first);
+
+		eliminated[pivot] = true;
+		eliminate(pivot, rows, sources);
+
+		// Degrees of the neighbors changed
+		for (int neighbor : neighbors)
+			queue.push(Entry((int)rows[neighbor].size(), neighbor));
+	}
+
+	int size = (int)portRows.size();
+	model._admittance.assign(size * size, 0.0);
+	model._sources.assign(size, 0.0);
+
+	for (int i = 0; i < size; ++i)
+	{
+		model._sources[i] = sources[portRows[i]];
+		for (int j = 0; j < size; ++j)
+		{
+			auto found = rows[portRows[i]].find(portRows[j]);
+			if (found != rows[portRows[i]].end())
+				model._admittance[i * size + j] = found->second;
+		}
+	}
+
+	/*
+		The rows describe supernodes, move them to the port nodes themselves.
+		Vsupernode = Vport - offset, so J becomes J + Y * offset
+	*/
+	int i = 0;
+	for (Node* port : ports)
+	{
+		for (int j = 0; j < size; ++j)
+			model._sources[j] += model._admittance[j * size + i] * getOffset(port);
+		++i;
+	}
+
+	return CircuitBase::Outcome();
+}
+
+template <typename Scalar>
+std::vector<int> BasicNodalSystem<Scalar>::order(const Ordering& ordering) const
+{
+	std::vector<int> reduced;
+	std::vector<std::map<int, Scalar>> matrix;
+	std::vector<std::vector<int>> graph;
+	ground(reduced, matrix, graph);
+
+	return ordering.cachedOrder(graph);
+}
+
+template <typename Scalar>
+int BasicNodalSystem<Scalar>::solve(const Ordering& ordering, bool mixedPrecision)
+{
+	std::vector<int> reduced;
+	std::vector<std::map<int, Scalar>> matrix;
+	std::vector<std::vector<int>> graph;
+	ground(reduced, matrix, graph);
+
+	std::vector<int> elimination = ordering.cachedOrder(graph);
+
+	std::vector<Scalar> values(matrix.size(), 0.0);
+	for (int i = 0; i < (int)_rows.size(); ++i)
+		if (reduced[i] != -1)
+			values[reduced[i]] = _sources[i];
+
+	// Everything above lives until the end, the factorization comes on top of it
+	std::size_t bytes = getBytes() + vectorBytes(reduced) + rowsBytes(matrix) + graphBytes(graph) + vectorBytes(elimination) + vectorBytes(values);
+	std::size_t factorBytes = 0;
+
+	int steps = -1;
+	if (mixedPrecision)
+		steps = refine(matrix, elimination, values, factorBytes);
+	_solveBytes = bytes + factorBytes;
+
+	// Refinement gave up, do it the usual way
+	if (steps == -1)
+	{
+		LdlFactorization<Scalar> factorization(matrix, elimination);
+		_solveBytes = std::max(_solveBytes, bytes + factorization.getBytes());
+		if (factorization.getFailedRow() != -1)
+		{
+			// Name a node of the supernode we couldn't find a potential for
+			int supernode = (int)(std::find(reduced.begin(), reduced.end(), factorization.getFailedRow()) - reduced.begin());
+			int node = (int)(std::find(_supernodes.begin(), _supernodes.end(), supernode) - _supernodes.begin());
+			_outcome = CircuitBase::Outcome::failure(CircuitBase::NOT_CONNECTED, "", _nodes[node]->getName());
+			return -1;
+		}
+		factorization.solve(values);
+	}
+
+	for (int i = 0; i < (int)_nodes.size(); ++i)
+	{
+		int row = reduced[_supernodes[i]];
+		_nodes[i]->_potential = (row == -1 ? Scalar(0) : values[row]) + _offsets[i];
+	}
+
+	// Current of each branch, and how much current leaves each node through branches
+	std::vector<Scalar> excess(_nodes.size(), 0.0);
+	for (Element* element : _branches)
+	{
+		element->_current = (element->_node1->_potential - element->_node2->_potential + element->_voltage) / element->_resistance;
+		if (std::abs(element->_voltage) <= ScalarTraits<Scalar>::zero())
+			element->_voltage = element->_current * element->_resistance;
+
+		excess[_indices.at(element->_node1)] += element->_current;
+		excess[_indices.at(element->_node2)] -= element->_current;
+	}
+
+	/*
+		The rest has to flow through the links, they form a forest inside each supernode.
+		Links closing a loop get no current
+	*/
+	std::vector<std::vector<int>> adjacency(_nodes.size());
+	for (int i = 0; i < (int)_links.size(); ++i)
+	{
+		_links[i]->_current = 0.0;
+		if (!_treeLinks[i])
+			continue;
+		adjacency[_indices.at(_links[i]->_node1)].push_back(i);
+		adjacency[_indices.at(_links[i]->_node2)].push_back(i);
+	}
+
+	std::vector<int> parentLinks(_nodes.size(), -1);
+	std::vector<bool> visited(_nodes.size(), false);
+	std::vector<int> order;
+	for (int root = 0; root < (int)_nodes.size(); ++root)
+	{
+		if (visited[root])
+			continue;
+
+		visited[root] = true;
+		order.push_back(root);
+		for (int k = (int)order.size() - 1; k < (int)order.size(); ++k)
+		{
+			for (int link : adjacency[order[k]])
+			{
+				Element* element = _links[link];
+				int other = _indices.at(element->_node1) == order[k] ? _indices.at(element->_node2) : _indices.at(element->_node1);
+				if (visited[other])
+					continue;
+
+				visited[other] = true;
+				parentLinks[other] = link;
+				order.push_back(other);
+			}
+		}
+	}
+
+	// Leaves first, a node sends everything it has left towards its parent
+	for (int k = (int)order.size() - 1; k >= 0; --k)
+	{
+		int node = order[k];
+		int link = parentLinks[node];
+		if (link == -1)
+			continue;
+
+		Element* element = _links[link];
+		Scalar flow = -excess[node];
+		int node1 = _indices.at(element->_node1);
+		int node2 = _indices.at(element->_node2);
+
+		element->_current = node1 == node ? flow : -flow;
+		excess[node1] += element->_current;
+		excess[node2] -= element->_current;
+	}
+
+	return steps;
+}
+
+template <typename Scalar>
+void BasicNodalSystem<Scalar>::benchmark(std::ostream& output) const
+{
+	std::vector<int> reduced;
+	std::vector<std::map<int, Scalar>> matrix;
+	std::vector<std::vector<int>> graph;
+	ground(reduced, matrix, graph);
+
+	long long entries = 0;
+	for (const std::vector<int>& neighbors : graph)
+		entries += neighbors.size();
+
+	output << "Rows: " << matrix.size() << ", nonzeros below the diagonal: " << entries / 2 << std::endl;
+
+	MinimumDegreeOrdering minimumDegree;
+	NestedDissectionOrdering nestedDissection;
+	RcmOrdering rcm;
+	AutoOrdering automatic;
+	const Ordering* orderings[] = { &minimumDegree, &nestedDissection, &rcm, &automatic };
+
+	for (const Ordering* ordering : orderings)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<int> order = ordering->order(graph);
+		auto ordered = std::chrono::high_resolution_clock::now();
+		LdlFactorization<Scalar> factorization(matrix, order);
+		auto factorized = std::chrono::high_resolution_clock::now();
+
+		output << ordering->getName() << ": ";
+		output << "fill " << factorization.getFill() << " ";
+		output << "order " << std::chrono::duration<double, std::milli>(ordered - start).count() << " ms ";
+		output << "factor " << std::chrono::duration<double, std::milli>(factorized - ordered).count() << " ms" << std::endl;
+	}
+}
+
+/*
+================= Private realization of class BasicNodalSystem =================
+*/
+
+template <typename Scalar>
+int BasicNodalSystem<Scalar>::find(int node)
+{
+	int parent = _parents[node];
+	if (parent == node)
+		return node;
+
+	int root = find(parent);
+	_offsets[node] += _offsets[parent];
+	_parents[node] = root;
+
+	return root;
+}
+
+template <typename Scalar>
+bool BasicNodalSystem<Scalar>::bind(int node1, int node2, Scalar voltage, bool battery)
+{
+	// V2 = V1 + voltage
+	int root1 = find(node1);
+	int root2 = find(node2);
+
+	if (root1 == root2)
+	{
+		// A loop of wires and batteries, it must add up to zero
+		if (std::abs(_offsets[node2] - _offsets[node1] - voltage) > ScalarTraits<Scalar>::zero())
+			_outcome = CircuitBase::Outcome::failure(battery ? CircuitBase::SHORT_CIRCUIT_WITH_BATTERY : CircuitBase::SHORT_CIRCUIT, "", _nodes[node1]->getName());
+		return false;
+	}
+
+	_parents[root2] = root1;
+	_offsets[root2] = _offsets[node1] + voltage - _offsets[node2];
+	return true;
+}
+
+template <typename Scalar>
+void BasicNodalSystem<Scalar>::stamp(int node1, int node2, Scalar conductance, Scalar current)
+{
+	// The element lives inside a supernode, its current doesn't change any potential
+	if (node1 == node2)
+		return;
+
+	_rows[node1][node1] += conductance;
+	_rows[node2][node2] += conductance;
+	_rows[node1][node2] -= conductance;
+	_rows[node2][node1] -= conductance;
+
+	_sources[node1] -= current;
+	_sources[node2] += current;
+}
+
+template <typename Scalar>
+void BasicNodalSystem<Scalar>::eliminate(int pivot, std::vector<std::map<int, Scalar>>& rows, std::vector<Scalar>& sources) const
+{
+	std::map<int, Scalar> row;
+	row.swap(rows[pivot]);
+
+	Scalar diagonal = row.count(pivot) ? row[pivot] : 0.0;
+
+	for (auto& neighbor : row)
+		if (neighbor.first != pivot)
+			rows[neighbor.first].erase(pivot);
+
+	/*
+		Nothing connects this part of the circuit to the ports, the diagonal is only what rounding left of it.
+		Measured against the node's own conductances, high impedance networks have small ones
+	*/
+	auto original = _rows[pivot].find(pivot);
+	Real scale = original != _rows[pivot].end() ? std::abs(original->second) : Real(0);
+	if (std::abs(diagonal) <= scale * std::numeric_limits<Real>::epsilon() * 1024)
+		return;
+
+	// Star-mesh in matrix form: Yij -= Yik * Ykj / Ykk
+	for (auto& rowEntry : row)
+	{
+		int i = rowEntry.first;
+		if (i == pivot)
+			continue;
+
+		Scalar factor = rowEntry.second / diagonal;
+		for (auto& columnEntry : row)
+		{
+			int j = columnEntry.first;
+			if (j == pivot)
+				continue;
+
+			rows[i][j] -= factor * columnEntry.second;
+		}
+		sources[i] -= factor * sources[pivot];
+	}
+	sources[pivot] = 0.0;
+}
+
+template <typename Scalar>
+void BasicNodalSystem<Scalar>::ground(std::vector<int>& reduced, std::vector<std::map<int, Scalar>>& matrix, std::vector<std::vector<int>>& graph) const
+{
+	// The first supernode of every connected part is the ground (0 volts) and gets no row
+	int size = (int)_rows.size();
+	reduced.assign(size, -1);
+	std::vector<bool> visited(size, false);
+	std::vector<int> queue;
+	int count = 0;
+
+	for (int root = 0; root < size; ++root)
+	{
+		if (visited[root])
+			continue;
+
+		visited[root] = true;
+		queue.assign(1, root);
+		for (int k = 0; k < (int)queue.size(); ++k)
+		{
+			for (auto& entry : _rows[queue[k]])
+			{
+				if (visited[entry.first])
+					continue;
+				visited[entry.first] = true;
+				reduced[entry.first] = count++;
+				queue.push_back(entry.first);
+			}
+		}
+	}
+
+	matrix.assign(count, std::map<int, Scalar>());
+	graph.assign(count, std::vector<int>());
+	for (int i = 0; i < size; ++i)
+	{
+		if (reduced[i] == -1)
+			continue;
+
+		for (auto& entry : _rows[i])
+		{
+			int j = reduced[entry.first];
+			if (j == -1)
+				continue;
+
+			matrix[reduced[i]][j] = entry.second;
+			if (j != reduced[i])
+				graph[reduced[i]].push_back(j);
+		}
+	}
+}
+
+template <typename Scalar>
+int BasicNodalSystem<Scalar>::refine(const std::vector<std::map<int, Scalar>>& matrix, const std::vector<int>& order, std::vector<Scalar>& values, std::size_t& bytes) const
+{
+	/*
+		Factorize in the low precision type (float for double), which moves half the bytes,
+		and fix the answer with residuals computed in Scalar from the original conductances.
+		Returns the number of refinement steps, or -1 when it stalls. bytes is what it allocates next to the matrix
+	*/
+	const int maxSteps = 10;
+	const Real tolerance = std::numeric_limits<Real>::epsilon() * 4096;
+
+	LdlFactorization<Scalar, Low> factorization(matrix, order);
+	// Conductances out of the range of the low precision type
+	if (factorization.getFailedRow() != -1)
+		return -1;
+
+	int size = (int)matrix.size();
+	std::vector<Scalar> sources = values;
+	std::vector<Scalar> residual(size);
+	bytes = factorization.getBytes() + vectorBytes(sources) + vectorBytes(residual);
+
+	Real sourcesNorm = 0;
+	for (const Scalar& source : sources)
+		sourcesNorm = std::max(sourcesNorm, std::abs(source));
+
+	factorization.solve(values);
+
+	int steps = 0;
+	Real lastNorm = -1;
+	while (true)
+	{
+		// r = J - Y * V
+		Real norm = 0;
+		for (int i = 0; i < size; ++i)
+		{
+			Scalar sum = sources[i];
+			for (auto& entry : matrix[i])
+				sum -= entry.second * values[entry.first];
+			residual[i] = sum;
+			norm = std::max(norm, std::abs(sum));
+		}
+
+		if (norm <= tolerance * sourcesNorm)
+			break;
+
+		// Too ill-conditioned for the low precision type, like huge resistance ratios
+		if (steps == maxSteps || !std::isfinite(norm) || (lastNorm >= 0 && norm > Real(0.5) * lastNorm))
+		{
+			steps = -1;
+			break;
+		}
+
+		factorization.solve(residual);
+		for (int i = 0; i < size; ++i)
+			values[i] += residual[i];
+
+		lastNorm = norm;
+		++steps;
+	}
+
+	if (steps == -1)
+		values = sources;
+
+	return steps;
+}
+
+template class BasicPortModel<float>;
+template class BasicPortModel<double>;
+template class BasicPortModel<long double>;
+template class BasicPortModel<std::complex<double>>;
+
+template class LdlFactorization<float>;
+template class LdlFactorization<double>;
+template class LdlFactorization<double, float>;
+template class LdlFactorization<long double>;
+template class LdlFactorization<long double, double>;
+template class LdlFactorization<std::complex<double>>;
+template class LdlFactorization<std::complex<double>, std::complex<float>>;
+
+template class BasicNodalSystem<float>;
+template class BasicNodalSystem<double>;
+template class BasicNodalSystem<long double>;
+template class BasicNodalSystem<std::complex<double>>;
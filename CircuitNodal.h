@@ -0,0 +1,104 @@
+#ifndef MF_CIRCUIT_NODAL_DEF
+#define MF_CIRCUIT_NODAL_DEF
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "CircuitCore.h"
+#include "CircuitOrdering.h"
+
+/*
+	Sparse L * D * L^T factorization of a symmetric matrix, eliminating rows in the given order.
+	Scalar is the type of the matrix and the values, Factor is the type the factors
+	are computed and stored in (float factors of a double matrix for mixed precision)
+*/
+template <typename Scalar, typename Factor = Scalar>
+class LdlFactorization
+{
+public:
+	LdlFactorization(const std::vector<std::map<int, Scalar>>& matrix, const std::vector<int>& order);
+
+	void solve(std::vector<Scalar>& values) const;
+	long long getFill() const;
+	std::size_t getBytes() const;
+
+	// Row whose pivot vanished or overflowed (the factorization is unusable then), or -1
+	int getFailedRow() const;
+
+private:
+	std::vector<int> _order;
+	std::vector<int> _positions;
+
+	// Columns of L in the eliminated order
+	std::vector<int> _columnStarts;
+	std::vector<int> _rows;
+	std::vector<Factor> _values;
+	std::vector<Factor> _diagonal;
+	int _failedRow = -1;
+};
+
+/*
+	Nodal equations (Y * V = J) of a circuit.
+	Wires and batteries without resistance fix the potential difference of their nodes,
+	so such nodes are glued together into a supernode and only supernodes get a row.
+	Nothing is thrown, check getOutcome() after building and after solving.
+*/
+template <typename Scalar>
+class BasicNodalSystem
+{
+	typedef BasicNode<Scalar> Node;
+	typedef BasicElement<Scalar> Element;
+	typedef BasicPortModel<Scalar> PortModel;
+	typedef typename ScalarTraits<Scalar>::Real Real;
+	typedef typename ScalarTraits<Scalar>::Low Low;
+
+public:
+	BasicNodalSystem(const BasicCircuitCore<Scalar>& circuit);
+
+	const CircuitBase::Outcome& getOutcome() const;
+	int getSize() const;
+	int getSupernode(Node* node) const;
+	Scalar getOffset(Node* node) const;
+	std::vector<std::vector<int>> getGraph() const;
+	CircuitBase::Outcome reduce(const mf::LinkedList<Node*>& ports, PortModel& model) const;
+	int solve(const Ordering& ordering, bool mixedPrecision = false);
+	// Bytes of the equations, and the largest footprint of the last solve() with its matrix and factorization
+	std::size_t getBytes() const;
+	std::size_t getSolveBytes() const;
+	// The elimination order solve() would use, to keep it (see StoredOrdering)
+	std::vector<int> order(const Ordering& ordering) const;
+	void benchmark(std::ostream& output) const;
+
+private:
+	int find(int node);
+	bool bind(int node1, int node2, Scalar voltage, bool battery);
+	void stamp(int node1, int node2, Scalar conductance, Scalar current);
+	void eliminate(int pivot, std::vector<std::map<int, Scalar>>& rows, std::vector<Scalar>& sources) const;
+	void ground(std::vector<int>& reduced, std::vector<std::map<int, Scalar>>& matrix, std::vector<std::vector<int>>& graph) const;
+	int refine(const std::vector<std::map<int, Scalar>>& matrix, const std::vector<int>& order, std::vector<Scalar>& values, std::size_t& bytes) const;
+
+private:
+	std::unordered_map<Node*, int> _indices;
+	std::vector<Node*> _nodes;
+
+	// Resistive elements get a conductance, wires and ideal batteries (links) glue nodes
+	std::vector<Element*> _branches;
+	std::vector<Element*> _links;
+	std::vector<bool> _treeLinks;
+
+	// Union-find of nodes, _offsets[i] is the potential of node i minus the potential of _parents[i]
+	std::vector<int> _parents;
+	std::vector<Scalar> _offsets;
+
+	// Supernode of each node, and one row per supernode
+	std::vector<int> _supernodes;
+	std::vector<std::map<int, Scalar>> _rows;
+	std::vector<Scalar> _sources;
+
+	CircuitBase::Outcome _outcome;
+	std::size_t _solveBytes = 0;
+};
+
+#endif // MF_CIRCUIT_NODAL_DEF
@@ -0,0 +1,422 @@
+#include "CircuitOrdering.h"
+#include <algorithm>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+
+/*
+================= Graph helpers =================
+*/
+
+// Breadth first search limited to the nodes whose mark equals the given tag
+class GraphSearch
+{
+public:
+	GraphSearch(const std::vector<std::vector<int>>& graph) : _graph(graph), _seen(graph.size(), 0) {}
+
+	std::vector<std::vector<int>> levels(int start, const std::vector<int>* marks, int tag)
+	{
+		std::vector<std::vector<int>> result;
+		++_stamp;
+
+		_seen[start] = _stamp;
+		result.push_back(std::vector<int>(1, start));
+
+		while (true)
+		{
+			std::vector<int> next;
+			for (int node : result.back())
+			{
+				for (int neighbor : _graph[node])
+				{
+					if (_seen[neighbor] == _stamp)
+						continue;
+					if (marks != nullptr && (*marks)[neighbor] != tag)
+						continue;
+
+					_seen[neighbor] = _stamp;
+					next.push_back(neighbor);
+				}
+			}
+
+			if (next.empty())
+				break;
+			result.push_back(next);
+		}
+
+		return result;
+	}
+
+	// A node far from everything else, a good place to start a level structure
+	int peripheral(int start, const std::vector<int>* marks, int tag)
+	{
+		int depth = (int)levels(start, marks, tag).size();
+
+		for (int tries = 0; tries < 8; ++tries)
+		{
+			std::vector<int> last = levels(start, marks, tag).back();
+			int candidate = last[0];
+			for (int node : last)
+				if (_graph[node].size() < _graph[candidate].size())
+					candidate = node;
+
+			int candidateDepth = (int)levels(candidate, marks, tag).size();
+			if (candidateDepth <= depth)
+				break;
+
+			start = candidate;
+			depth = candidateDepth;
+		}
+
+		return start;
+	}
+
+private:
+	const std::vector<std::vector<int>>& _graph;
+	std::vector<int> _seen;
+	int _stamp = 0;
+};
+
+static std::vector<int> orderInduced(const std::vector<std::vector<int>>& graph, const std::vector<int>& part, const std::vector<int>& marks, int tag)
+{
+	// Renumber the part from zero, order it by minimum degree and map it back
+	std::unordered_map<int, int> local;
+	for (int i = 0; i < (int)part.size(); ++i)
+		local[part[i]] = i;
+
+	std::vector<std::vector<int>> subgraph(part.size());
+	for (int i = 0; i < (int)part.size(); ++i)
+		for (int neighbor : graph[part[i]])
+			if (marks[neighbor] == tag)
+				subgraph[i].push_back(local[neighbor]);
+
+	std::vector<int> result;
+	for (int node : MinimumDegreeOrdering().order(subgraph))
+		result.push_back(part[node]);
+
+	return result;
+}
+
+static void dissect(const std::vector<std::vector<int>>& graph, const std::vector<int>& part, GraphSearch& search, std::vector<int>& marks, int& tag, std::vector<int>& result)
+{
+	const int leafSize = 64;
+
+	if (part.empty())
+		return;
+
+	int partTag = ++tag;
+	for (int node : part)
+		marks[node] = partTag;
+
+	if ((int)part.size() <= leafSize)
+	{
+		std::vector<int> leaf = orderInduced(graph, part, marks, partTag);
+		result.insert(result.end(), leaf.begin(), leaf.end());
+		return;
+	}
+
+	int start = search.peripheral(part[0], &marks, partTag);
+	std::vector<std::vector<int>> levels = search.levels(start, &marks, partTag);
+
+	// The part isn't connected, handle the component we found and the rest separately
+	int reached = 0;
+	for (const std::vector<int>& level : levels)
+		reached += (int)level.size();
+
+	if (reached < (int)part.size())
+	{
+		std::vector<int> component;
+		for (const std::vector<int>& level : levels)
+			component.insert(component.end(), level.begin(), level.end());
+
+		int componentTag = ++tag;
+		for (int node : component)
+			marks[node] = componentTag;
+
+		std::vector<int> rest;
+		for (int node : part)
+			if (marks[node] == partTag)
+				rest.push_back(node);
+
+		dissect(graph, component, search, marks, tag, result);
+		dissect(graph, rest, search, marks, tag, result);
+		return;
+	}
+
+	// Too dense to split with a level
+	if (levels.size() < 3)
+	{
+		std::vector<int> leaf = orderInduced(graph, part, marks, partTag);
+		result.insert(result.end(), leaf.begin(), leaf.end());
+		return;
+	}
+
+	// A level only touches the levels next to it, so the middle one is a separator
+	int middle = 0;
+	int count = 0;
+	while (count + (int)levels[middle].size() < (int)part.size() / 2)
+		count += (int)levels[middle++].size();
+	middle = std::max(1, std::min(middle, (int)levels.size() - 2));
+
+	std::vector<int> first;
+	std::vector<int> second;
+	for (int i = 0; i < middle; ++i)
+		first.insert(first.end(), levels[i].begin(), levels[i].end());
+	for (int i = middle + 1; i < (int)levels.size(); ++i)
+		second.insert(second.end(), levels[i].begin(), levels[i].end());
+
+	dissect(graph, first, search, marks, tag, result);
+	dissect(graph, second, search, marks, tag, result);
+	result.insert(result.end(), levels[middle].begin(), levels[middle].end());
+}
+
+/*
+================= Public realization of class Ordering =================
+*/
+
+Ordering::~Ordering() {}
+
+std::vector<int> Ordering::cachedOrder(const std::vector<std::vector<int>>& graph) const
+{
+	if (!cacheable())
+		return order(graph);
+
+	static std::mutex mutex;
+	static std::unordered_map<size_t, std::vector<int>> cache;
+
+	// Hash of the topology, a collision only costs us a worse ordering
+	size_t key = std::hash<std::string>()(getName());
+	key = key * 31 + graph.size();
+	for (const std::vector<int>& neighbors : graph)
+	{
+		key = key * 1099511628211ULL + neighbors.size();
+		for (int neighbor : neighbors)
+			key = key * 1099511628211ULL + neighbor;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = cache.find(key);
+		if (found != cache.end() && found->second.size() == graph.size())
+			return found->second;
+	}
+
+	std::vector<int> result = order(graph);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cache.size() >= 256)
+		cache.clear();
+	cache[key] = result;
+
+	return result;
+}
+
+bool Ordering::cacheable() const { return true; }
+
+long long Ordering::countFill(const std::vector<std::vector<int>>& graph, const std::vector<int>& order)
+{
+	int size = (int)graph.size();
+	std::vector<int> positions(size);
+	for (int i = 0; i < size; ++i)
+		positions[order[i]] = i;
+
+	// Walk the elimination tree from every nonzero of a row, each node we pass is a nonzero of L
+	std::vector<int> parents(size, -1);
+	std::vector<int> flags(size, -1);
+	long long fill = 0;
+
+	for (int k = 0; k < size; ++k)
+	{
+		flags[k] = k;
+		for (int neighbor : graph[order[k]])
+		{
+			for (int i = positions[neighbor]; i < k && flags[i] != k; i = parents[i])
+			{
+				if (parents[i] == -1)
+					parents[i] = k;
+				++fill;
+				flags[i] = k;
+			}
+		}
+	}
+
+	return fill;
+}
+
+/*
+================= Public realization of class MinimumDegreeOrdering =================
+*/
+
+std::string MinimumDegreeOrdering::getName() const { return "Minimum degree"; }
+
+std::vector<int> MinimumDegreeOrdering::order(const std::vector<std::vector<int>>& graph) const
+{
+	int size = (int)graph.size();
+	std::vector<std::vector<int>> neighbors = graph;
+	std::vector<bool> eliminated(size, false);
+	std::vector<int> result;
+
+	for (std::vector<int>& list : neighbors)
+	{
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+	}
+
+	typedef std::pair<int, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	for (int i = 0; i < size; ++i)
+		queue.push(Entry((int)neighbors[i].size(), i));
+
+	while (!queue.empty())
+	{
+		Entry entry = queue.top();
+		queue.pop();
+
+		int node = entry.second;
+		if (eliminated[node] || entry.first != (int)neighbors[node].size())
+			continue;
+
+		eliminated[node] = true;
+		result.push_back(node);
+
+		// The neighbors of the eliminated node become a clique
+		std::vector<int> clique;
+		clique.swap(neighbors[node]);
+
+		for (int neighbor : clique)
+		{
+			std::vector<int> merged;
+			std::set_union(neighbors[neighbor].begin(), neighbors[neighbor].end(), clique.begin(), clique.end(), std::back_inserter(merged));
+			merged.erase(std::remove_if(merged.begin(), merged.end(), [&](int other) { return other == neighbor || eliminated[other]; }), merged.end());
+
+			neighbors[neighbor].swap(merged);
+			queue.push(Entry((int)neighbors[neighbor].size(), neighbor));
+		}
+	}
+
+	return result;
+}
+
+/*
+================= Public realization of class NestedDissectionOrdering =================
+*/
+
+std::string NestedDissectionOrdering::getName() const { return "Nested dissection"; }
+
+std::vector<int> NestedDissectionOrdering::order(const std::vector<std::vector<int>>& graph) const
+{
+	std::vector<int> part(graph.size());
+	for (int i = 0; i < (int)graph.size(); ++i)
+		part[i] = i;
+
+	GraphSearch search(graph);
+	std::vector<int> marks(graph.size(), 0);
+	std::vector<int> result;
+	int tag = 0;
+
+	dissect(graph, part, search, marks, tag, result);
+
+	return result;
+}
+
+/*
+================= Public realization of class RcmOrdering =================
+*/
+
+std::string RcmOrdering::getName() const { return "Reverse Cuthill-McKee"; }
+
+std::vector<int> RcmOrdering::order(const std::vector<std::vector<int>>& graph) const
+{
+	int size = (int)graph.size();
+	GraphSearch search(graph);
+	std::vector<bool> placed(size, false);
+	std::vector<int> result;
+
+	for (int i = 0; i < size; ++i)
+	{
+		if (placed[i])
+			continue;
+
+		// Cuthill-McKee: breadth first, visiting neighbors with fewer neighbors first
+		int start = search.peripheral(i, nullptr, 0);
+		int first = (int)result.size();
+		placed[start] = true;
+		result.push_back(start);
+
+		for (int k = first; k < (int)result.size(); ++k)
+		{
+			std::vector<int> next;
+			for (int neighbor : graph[result[k]])
+			{
+				if (placed[neighbor])
+					continue;
+				placed[neighbor] = true;
+				next.push_back(neighbor);
+			}
+
+			std::sort(next.begin(), next.end(), [&](int a, int b) { return graph[a].size() < graph[b].size(); });
+			result.insert(result.end(), next.begin(), next.end());
+		}
+	}
+
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+/*
+================= Public realization of class AutoOrdering =================
+*/
+
+std::string AutoOrdering::getName() const { return "Auto"; }
+
+std::vector<int> AutoOrdering::order(const std::vector<std::vector<int>>& graph) const
+{
+	MinimumDegreeOrdering minimumDegree;
+	NestedDissectionOrdering nestedDissection;
+	RcmOrdering rcm;
+	const Ordering* orderings[] = { &minimumDegree, &nestedDissection, &rcm };
+
+	std::vector<int> best;
+	long long bestFill = -1;
+	for (const Ordering* ordering : orderings)
+	{
+		std::vector<int> candidate = ordering->order(graph);
+		long long fill = countFill(graph, candidate);
+
+		if (bestFill == -1 || fill < bestFill)
+		{
+			best.swap(candidate);
+			bestFill = fill;
+		}
+	}
+
+	return best;
+}
+
+/*
+================= Public realization of class StoredOrdering =================
+*/
+
+StoredOrdering::StoredOrdering(std::vector<int> order, const Ordering* fallback) : _order(std::move(order)), _fallback(fallback) { }
+
+std::string StoredOrdering::getName() const { return "Stored"; }
+
+bool StoredOrdering::cacheable() const { return false; }
+
+std::vector<int> StoredOrdering::order(const std::vector<std::vector<int>>& graph) const
+{
+	// Only a permutation of the rows is an order
+	bool valid = _order.size() == graph.size();
+	std::vector<bool> seen(graph.size(), false);
+	for (int i = 0; valid && i < (int)_order.size(); ++i)
+	{
+		valid = _order[i] >= 0 && _order[i] < (int)graph.size() && !seen[_order[i]];
+		if (valid)
+			seen[_order[i]] = true;
+	}
+	if (valid)
+		return _order;
+
+	AutoOrdering automatic;
+	return _fallback != nullptr ? _fallback->order(graph) : automatic.order(graph);
+}
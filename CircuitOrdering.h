@@ -0,0 +1,76 @@
+#ifndef MF_CIRCUIT_ORDERING_DEF
+#define MF_CIRCUIT_ORDERING_DEF
+
+#include <string>
+#include <vector>
+
+/*
+	Elimination order of the nodal equations.
+	The graph has one list of neighbors per row, the order is a permutation of the rows,
+	and a good one keeps the fill-in of the factorization small
+*/
+class Ordering
+{
+public:
+	virtual ~Ordering();
+
+	virtual std::string getName() const = 0;
+	virtual std::vector<int> order(const std::vector<std::vector<int>>& graph) const = 0;
+
+	// Same as order(), but remembers the result for every topology it has seen
+	std::vector<int> cachedOrder(const std::vector<std::vector<int>>& graph) const;
+	// False when the order depends on more than the name and the graph, cachedOrder() then always orders again
+	virtual bool cacheable() const;
+
+	static long long countFill(const std::vector<std::vector<int>>& graph, const std::vector<int>& order);
+};
+
+// Eliminates the node with the fewest neighbors first, good for random and tree-like circuits
+class MinimumDegreeOrdering : public Ordering
+{
+public:
+	std::string getName() const override;
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override;
+};
+
+// Splits the graph with small separators and eliminates the separators last, good for grids
+class NestedDissectionOrdering : public Ordering
+{
+public:
+	std::string getName() const override;
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override;
+};
+
+// Reverse Cuthill-McKee, keeps the matrix banded, good for ladders and chains
+class RcmOrdering : public Ordering
+{
+public:
+	std::string getName() const override;
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override;
+};
+
+// Tries every ordering above and keeps the one with the least fill-in
+class AutoOrdering : public Ordering
+{
+public:
+	std::string getName() const override;
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override;
+};
+
+// An order computed before (like the one saved with a binary circuit), the fallback orders graphs of another size
+class StoredOrdering : public Ordering
+{
+public:
+	StoredOrdering(std::vector<int> order, const Ordering* fallback = nullptr);
+
+	std::string getName() const override;
+	std::vector<int> order(const std::vector<std::vector<int>>& graph) const override;
+	// Every stored ordering has the same name
+	bool cacheable() const override;
+
+private:
+	std::vector<int> _order;
+	const Ordering* _fallback = nullptr;
+};
+
+#endif // MF_CIRCUIT_ORDERING_DEF
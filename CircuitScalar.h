@@ -0,0 +1,89 @@
+#ifndef MF_CIRCUIT_SCALAR_DEF
+#define MF_CIRCUIT_SCALAR_DEF
+
+#include <cmath>
+#include <complex>
+
+/*
+	What the circuit core needs to know about the type of its values.
+	Real is the type of magnitudes, Low is a cheaper type used to factorize in mixed precision.
+	zero() is the magnitude below which a voltage or resistance counts as nothing,
+	shortCircuit() is the resistance below which an element shorts its nodes,
+	and magnitude() measures a value for those comparisons.
+	fileType() tells the types apart in binary files
+*/
+template <typename Scalar>
+class ScalarTraits;
+
+template <>
+class ScalarTraits<float>
+{
+public:
+	typedef float Real;
+	typedef float Low;
+
+	static constexpr Real zero() { return 0.0001f; }
+	static constexpr Real shortCircuit() { return 0.00001f; }
+	static bool finite(float value) { return std::isfinite(value); }
+	static Real magnitude(float value) { return std::abs(value); }
+	static constexpr unsigned fileType() { return 1; }
+};
+
+template <>
+class ScalarTraits<double>
+{
+public:
+	typedef double Real;
+	typedef float Low;
+
+	static constexpr Real zero() { return 0.00001; }
+	static constexpr Real shortCircuit() { return 0.000001; }
+	static bool finite(double value) { return std::isfinite(value); }
+	static Real magnitude(double value) { return std::abs(value); }
+	static constexpr unsigned fileType() { return 2; }
+};
+
+template <>
+class ScalarTraits<long double>
+{
+public:
+	typedef long double Real;
+	typedef double Low;
+
+	static constexpr Real zero() { return 0.00001L; }
+	static constexpr Real shortCircuit() { return 0.000001L; }
+	static bool finite(long double value) { return std::isfinite(value); }
+	static Real magnitude(long double value) { return std::abs(value); }
+	static constexpr unsigned fileType() { return 3; }
+};
+
+// Impedances and phasors for AC circuits
+template <>
+class ScalarTraits<std::complex<double>>
+{
+public:
+	typedef double Real;
+	typedef std::complex<float> Low;
+
+	static constexpr Real zero() { return 0.00001; }
+	static constexpr Real shortCircuit() { return 0.000001; }
+	static bool finite(const std::complex<double>& value) { return std::isfinite(value.real()) && std::isfinite(value.imag()); }
+	static Real magnitude(const std::complex<double>& value) { return std::abs(value); }
+	static constexpr unsigned fileType() { return 4; }
+};
+
+template <>
+class ScalarTraits<std::complex<float>>
+{
+public:
+	typedef float Real;
+	typedef std::complex<float> Low;
+
+	static constexpr Real zero() { return 0.0001f; }
+	static constexpr Real shortCircuit() { return 0.00001f; }
+	static bool finite(const std::complex<float>& value) { return std::isfinite(value.real()) && std::isfinite(value.imag()); }
+	static Real magnitude(const std::complex<float>& value) { return std::abs(value); }
+	static constexpr unsigned fileType() { return 5; }
+};
+
+#endif // MF_CIRCUIT_SCALAR_DEF
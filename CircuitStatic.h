@@ -0,0 +1,283 @@
+#ifndef MF_CIRCUIT_STATIC_DEF
+#define MF_CIRCUIT_STATIC_DEF
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include "CircuitCore.h"
+#include "CircuitScalar.h"
+
+/*
+	Series and parallel circuits with a topology fixed at compile time.
+	The topology is a type, the values of the elements are an array, and
+	solving is straight-line code: no heap, no linked lists, no searching for connections.
+
+	Every element goes from its negative side (node1) to its positive side (node2), like in CircuitCore.
+	StaticSeries<A, B> puts the positive side of A on the negative side of B,
+	StaticParallel<A, B> ties the negative sides together and the positive sides together,
+	and StaticFlip<A> turns A around. The whole topology is one loop closed on itself,
+	so it gives the same currents as CircuitCore::solve() on the same circuit.
+
+	With constant values the circuit is solved at compile time:
+
+		typedef StaticSeries<StaticResistor<0>, StaticBattery<1>, StaticResistor<2>, StaticFlip<StaticBattery<3>>> Loop;
+		constexpr auto result = StaticCircuit<double, Loop>::solve({ 5, 24, 5, 12 });
+		static_assert(result.currents[0] == 1.2, "");
+*/
+
+template <typename Scalar, size_t Count>
+struct StaticResult
+{
+	// Indexed like the values, currents go from node1 to node2 of each element
+	std::array<Scalar, Count> currents{};
+	std::array<Scalar, Count> voltages{};
+};
+
+// std::abs isn't constexpr
+template <typename Scalar>
+constexpr bool staticIsShort(const Scalar& resistance)
+{
+	return resistance < ScalarTraits<Scalar>::shortCircuit() && -resistance < ScalarTraits<Scalar>::shortCircuit();
+}
+
+template <typename Real>
+inline bool staticIsShort(const std::complex<Real>& resistance)
+{
+	return std::abs(resistance) < ScalarTraits<std::complex<Real>>::shortCircuit();
+}
+
+constexpr size_t staticMax(size_t a, size_t b)
+{
+	return a > b ? a : b;
+}
+
+// The Thevenin equivalent of a part, reduce() fills it in once from the leaves up
+// and distribute() walks back down the same tree instead of asking the children again
+template <typename Scalar>
+struct StaticThevenin
+{
+	Scalar voltage{};
+	Scalar resistance{};
+};
+
+/*
+================= Elements =================
+*/
+
+// values[Index] is the resistance
+template <size_t Index>
+struct StaticResistor
+{
+	static constexpr size_t count = Index + 1;
+
+	template <typename Scalar>
+	using Reduced = StaticThevenin<Scalar>;
+
+	template <typename Scalar, size_t Count>
+	static constexpr void reduce(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		reduced.resistance = values[Index];
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void distribute(const std::array<Scalar, Count>& values, const Reduced<Scalar>&, const Scalar& current, StaticResult<Scalar, Count>& result)
+	{
+		result.currents[Index] = current;
+		result.voltages[Index] = current * values[Index];
+	}
+};
+
+// values[Index] is the voltage, the battery itself has no resistance
+template <size_t Index>
+struct StaticBattery
+{
+	static constexpr size_t count = Index + 1;
+
+	template <typename Scalar>
+	using Reduced = StaticThevenin<Scalar>;
+
+	template <typename Scalar, size_t Count>
+	static constexpr void reduce(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		reduced.voltage = values[Index];
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void distribute(const std::array<Scalar, Count>& values, const Reduced<Scalar>&, const Scalar& current, StaticResult<Scalar, Count>& result)
+	{
+		result.currents[Index] = current;
+		result.voltages[Index] = values[Index];
+	}
+};
+
+template <typename Child>
+struct StaticFlip
+{
+	static constexpr size_t count = Child::count;
+
+	template <typename Scalar>
+	struct Reduced : StaticThevenin<Scalar>
+	{
+		typename Child::template Reduced<Scalar> child;
+	};
+
+	template <typename Scalar, size_t Count>
+	static constexpr void reduce(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		Child::reduce(values, reduced.child);
+		reduced.voltage = -reduced.child.voltage;
+		reduced.resistance = reduced.child.resistance;
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void distribute(const std::array<Scalar, Count>& values, const Reduced<Scalar>& reduced, const Scalar& current, StaticResult<Scalar, Count>& result)
+	{
+		Child::distribute(values, reduced.child, -current, result);
+	}
+};
+
+/*
+================= Connections =================
+*/
+
+template <typename First, typename... Rest>
+struct StaticSeries
+{
+	static constexpr size_t count = staticMax(First::count, StaticSeries<Rest...>::count);
+
+	template <typename Scalar>
+	struct Reduced : StaticThevenin<Scalar>
+	{
+		typename First::template Reduced<Scalar> first;
+		typename StaticSeries<Rest...>::template Reduced<Scalar> rest;
+	};
+
+	template <typename Scalar, size_t Count>
+	static constexpr void reduce(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		First::reduce(values, reduced.first);
+		StaticSeries<Rest...>::reduce(values, reduced.rest);
+		reduced.voltage = reduced.first.voltage + reduced.rest.voltage;
+		reduced.resistance = reduced.first.resistance + reduced.rest.resistance;
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void distribute(const std::array<Scalar, Count>& values, const Reduced<Scalar>& reduced, const Scalar& current, StaticResult<Scalar, Count>& result)
+	{
+		First::distribute(values, reduced.first, current, result);
+		StaticSeries<Rest...>::distribute(values, reduced.rest, current, result);
+	}
+};
+
+template <typename Last>
+struct StaticSeries<Last> : Last {};
+
+template <typename First, typename... Rest>
+struct StaticParallel
+{
+	static constexpr size_t count = staticMax(First::count, StaticParallel<Rest...>::count);
+
+	template <typename Scalar>
+	struct Reduced : StaticThevenin<Scalar>
+	{
+		// Over this child and the ones after it
+		Scalar conductance{};
+		Scalar currentSum{};
+		typename First::template Reduced<Scalar> first;
+		typename StaticParallel<Rest...>::template Reduced<Scalar> rest;
+	};
+
+	// Batteries with resistance follow Millman's theorem, E = sum(Ei / Ri) * R
+	template <typename Scalar, size_t Count>
+	static constexpr void reduce(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		sum(values, reduced);
+		reduced.resistance = Scalar(1) / reduced.conductance;
+		reduced.voltage = reduced.currentSum * reduced.resistance;
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void distribute(const std::array<Scalar, Count>& values, const Reduced<Scalar>& reduced, const Scalar& current, StaticResult<Scalar, Count>& result)
+	{
+		// Every child sees the same voltage, V2 - V1 = E - I * R
+		Scalar across = reduced.voltage - current * reduced.resistance;
+		spread(values, reduced, across, result);
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void sum(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		First::reduce(values, reduced.first);
+		if (staticIsShort(reduced.first.resistance))
+			throw CircuitBase::SHORT_CIRCUIT_WITH_BATTERY;
+
+		StaticParallel<Rest...>::sum(values, reduced.rest);
+		reduced.conductance = Scalar(1) / reduced.first.resistance + reduced.rest.conductance;
+		reduced.currentSum = reduced.first.voltage / reduced.first.resistance + reduced.rest.currentSum;
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void spread(const std::array<Scalar, Count>& values, const Reduced<Scalar>& reduced, const Scalar& across, StaticResult<Scalar, Count>& result)
+	{
+		First::distribute(values, reduced.first, (reduced.first.voltage - across) / reduced.first.resistance, result);
+		StaticParallel<Rest...>::spread(values, reduced.rest, across, result);
+	}
+};
+
+template <typename Last>
+struct StaticParallel<Last>
+{
+	static constexpr size_t count = Last::count;
+
+	template <typename Scalar>
+	struct Reduced
+	{
+		Scalar conductance{};
+		Scalar currentSum{};
+		typename Last::template Reduced<Scalar> first;
+	};
+
+	template <typename Scalar, size_t Count>
+	static constexpr void sum(const std::array<Scalar, Count>& values, Reduced<Scalar>& reduced)
+	{
+		Last::reduce(values, reduced.first);
+		if (staticIsShort(reduced.first.resistance))
+			throw CircuitBase::SHORT_CIRCUIT_WITH_BATTERY;
+
+		reduced.conductance = Scalar(1) / reduced.first.resistance;
+		reduced.currentSum = reduced.first.voltage / reduced.first.resistance;
+	}
+
+	template <typename Scalar, size_t Count>
+	static constexpr void spread(const std::array<Scalar, Count>& values, const Reduced<Scalar>& reduced, const Scalar& across, StaticResult<Scalar, Count>& result)
+	{
+		Last::distribute(values, reduced.first, (reduced.first.voltage - across) / reduced.first.resistance, result);
+	}
+};
+
+/*
+================= Solver =================
+*/
+
+template <typename Scalar, typename Topology>
+class StaticCircuit
+{
+public:
+	static constexpr size_t size = Topology::count;
+	typedef std::array<Scalar, size> Values;
+	typedef StaticResult<Scalar, size> Result;
+
+	static constexpr Result solve(const Values& values)
+	{
+		typename Topology::template Reduced<Scalar> reduced{};
+		Topology::reduce(values, reduced);
+		if (staticIsShort(reduced.resistance))
+			throw CircuitBase::SHORT_CIRCUIT;
+
+		Result result;
+		Topology::distribute(values, reduced, reduced.voltage / reduced.resistance, result);
+		return result;
+	}
+};
+
+#endif // MF_CIRCUIT_STATIC_DEF
@@ -0,0 +1,155 @@
+#include "CircuitTrace.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+	const char* name;
+	int64_t begin;
+	int64_t end;
+};
+
+// Written only by its thread, count is published after each event so write() can read up to it
+struct TraceBuffer
+{
+	int thread = 0;
+	size_t capacity = 0;
+	std::unique_ptr<TraceEvent[]> events;
+	std::atomic<size_t> count{ 0 };
+	std::atomic<long long> dropped{ 0 };
+};
+
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+// Buffers outlive their threads, so spans of finished workers are still written
+static std::mutex traceMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> traceBuffers;
+static size_t traceCapacity = 1 << 16;
+static thread_local TraceBuffer* threadBuffer = nullptr;
+
+// Once per thread, the first time it records, threads are numbered in that order
+static TraceBuffer* registerThread()
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	std::unique_ptr<TraceBuffer> buffer(new TraceBuffer());
+	buffer->thread = (int)traceBuffers.size() + 1;
+	buffer->capacity = traceCapacity;
+	buffer->events.reset(new TraceEvent[traceCapacity]);
+	traceBuffers.push_back(std::move(buffer));
+
+	return traceBuffers.back().get();
+}
+
+static void writeTraceText(std::ostream& output, const char* text)
+{
+	output << '"';
+	for (const char* c = text; *c != '\0'; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			output << '\\';
+		output << *c;
+	}
+	output << '"';
+}
+
+/*
+================= Public realization of class CircuitTrace =================
+*/
+
+std::atomic<bool> CircuitTrace::_enabled{ false };
+
+void CircuitTrace::start(size_t eventsPerThread)
+{
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		traceCapacity = eventsPerThread;
+	}
+	_enabled.store(true, std::memory_order_relaxed);
+}
+
+void CircuitTrace::stop()
+{
+	_enabled.store(false, std::memory_order_relaxed);
+}
+
+void CircuitTrace::write(std::ostream& output)
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+
+	// Microseconds, the unit of the format
+	output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char* separator = "\n";
+	for (const std::unique_ptr<TraceBuffer>& buffer : traceBuffers)
+	{
+		output << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread;
+		output << ",\"args\":{\"name\":\"thread " << buffer->thread << "\"}}";
+		separator = ",\n";
+
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const TraceEvent& event = buffer->events[i];
+			output << separator << "{\"name\":";
+			writeTraceText(output, event.name);
+			output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread;
+			output << ",\"ts\":" << event.begin / 1000 << '.' << event.begin / 100 % 10;
+			output << ",\"dur\":" << (event.end - event.begin) / 1000 << '.' << (event.end - event.begin) / 100 % 10 << "}";
+		}
+	}
+	output << "\n]}\n";
+}
+
+bool CircuitTrace::save(const std::string& path)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	write(file);
+	return file.good();
+}
+
+void CircuitTrace::clear()
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	for (const std::unique_ptr<TraceBuffer>& buffer : traceBuffers)
+	{
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+	}
+}
+
+long long CircuitTrace::getDropped()
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	long long dropped = 0;
+	for (const std::unique_ptr<TraceBuffer>& buffer : traceBuffers)
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+
+	return dropped;
+}
+
+int64_t CircuitTrace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void CircuitTrace::record(const char* name, int64_t begin, int64_t end)
+{
+	TraceBuffer* buffer = threadBuffer;
+	if (buffer == nullptr)
+		buffer = threadBuffer = registerThread();
+
+	size_t count = buffer->count.load(std::memory_order_relaxed);
+	if (count == buffer->capacity)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[count] = { name, begin, end };
+	buffer->count.store(count + 1, std::memory_order_release);
+}
@@ -0,0 +1,76 @@
+#ifndef MF_CIRCUIT_TRACE_DEF
+#define MF_CIRCUIT_TRACE_DEF
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+	Timed spans of a whole session, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev):
+
+		CircuitTrace::start();
+		{
+			TraceSpan span("createAndSolveCircuit");
+			...
+		}
+		CircuitTrace::save("trace.json");
+
+	Every thread writes its spans into a buffer of its own without taking a lock, and write() reads
+	them while threads keep tracing. While tracing is off, a span costs one relaxed atomic load.
+	Names aren't copied, so they have to be string literals. A thread keeps up to eventsPerThread
+	spans, later ones are dropped and counted.
+*/
+class CircuitTrace
+{
+public:
+	static void start(size_t eventsPerThread = 1 << 16);
+	static void stop();
+	static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+	// Everything recorded since the program started or since clear()
+	static void write(std::ostream& output);
+	static bool save(const std::string& path);
+	// Only while no thread is inside a span
+	static void clear();
+	static long long getDropped();
+
+	// Nanoseconds since the program started
+	static int64_t now();
+	static void record(const char* name, int64_t begin, int64_t end);
+
+private:
+	static std::atomic<bool> _enabled;
+};
+
+// Records the time from its construction to its destruction, if tracing was on when it started
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name) : _name(name), _begin(CircuitTrace::enabled() ? CircuitTrace::now() : -1) { }
+	~TraceSpan() { end(); }
+
+	// Ends this span and starts the next one, for phases that follow each other
+	void next(const char* name)
+	{
+		end();
+		_name = name;
+		_begin = CircuitTrace::enabled() ? CircuitTrace::now() : -1;
+	}
+
+private:
+	TraceSpan(const TraceSpan& span);
+	void operator = (const TraceSpan& span);
+
+	void end()
+	{
+		if (_begin >= 0)
+			CircuitTrace::record(_name, _begin, CircuitTrace::now());
+		_begin = -1;
+	}
+
+	const char* _name;
+	int64_t _begin;
+};
+
+#endif // MF_CIRCUIT_TRACE_DEF
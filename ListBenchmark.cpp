@@ -0,0 +1,311 @@
+#include "mfLinkedList.h"
+#include "mfUnrolledList.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/*
+	Timings of the mf containers against the obvious alternatives:
+	every call the core and the GUI make on their lists, for mf::LinkedList, mf::UnrolledList,
+	std::vector, std::list and std::deque at a few sizes, then mf::getIntersection.
+	Calls that cost a walk through the container (like indexing a linked list) are skipped
+	past a few thousand values, where they would take most of the run.
+	Build it on its own, with optimizations:
+
+		g++ -O2 -o ListBenchmark ListBenchmark.cpp -std=c++17
+*/
+
+// The intersection before lookups, list2.find for every value of list1
+template <typename DataType>
+static mf::LinkedList<DataType> scanIntersection(const mf::LinkedList<DataType>& list1, const mf::LinkedList<DataType>& list2)
+{
+	mf::LinkedList<DataType> intersection;
+	for (DataType& cur : list1)
+		if (list2.find(cur) != nullptr)
+			intersection.pushBack(cur);
+	return intersection;
+}
+
+// Milliseconds per call, repeated until it took a while
+template <typename Function>
+static double measure(Function function)
+{
+	int repeats = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	auto now = start;
+	do
+	{
+		function();
+		++repeats;
+		now = std::chrono::high_resolution_clock::now();
+	} while (now - start < std::chrono::milliseconds(100));
+
+	return std::chrono::duration<double, std::milli>(now - start).count() / repeats;
+}
+
+// Keeps results alive, so the compiler can't drop the loops that compute them
+static volatile size_t benchmarkSink;
+
+// Values like the core stores, pointers to elements
+typedef int* Value;
+
+// The same calls on every container, std ones first and then the mf ones
+template <typename List, typename DataType>
+static void pushBack(List& list, DataType value) { list.push_back(value); }
+template <typename List, typename DataType>
+static void pushFront(List& list, DataType value) { list.insert(list.begin(), value); }
+template <typename List, typename DataType>
+static bool contains(const List& list, DataType value) { return std::find(list.begin(), list.end(), value) != list.end(); }
+template <typename List, typename DataType>
+static void removeValue(List& list, DataType value) { list.erase(std::find(list.begin(), list.end(), value)); }
+template <typename List>
+static Value at(List& list, int index) { return list[index]; }
+static Value at(std::list<Value>& list, int index) { return *std::next(list.begin(), index); }
+
+template <typename DataType>
+static void pushBack(mf::LinkedList<DataType>& list, DataType value) { list.pushBack(value); }
+template <typename DataType>
+static void pushFront(mf::LinkedList<DataType>& list, DataType value) { list.pushFront(value); }
+template <typename DataType>
+static bool contains(const mf::LinkedList<DataType>& list, DataType value) { return list.find(value) != nullptr; }
+template <typename DataType>
+static void removeValue(mf::LinkedList<DataType>& list, DataType value) { list.remove(value); }
+
+template <typename DataType>
+static void pushBack(mf::UnrolledList<DataType>& list, DataType value) { list.pushBack(value); }
+template <typename DataType>
+static void pushFront(mf::UnrolledList<DataType>& list, DataType value) { list.pushFront(value); }
+template <typename DataType>
+static bool contains(const mf::UnrolledList<DataType>& list, DataType value) { return list.find(value) != nullptr; }
+template <typename DataType>
+static void removeValue(mf::UnrolledList<DataType>& list, DataType value) { list.remove(value); }
+
+enum ListOperation
+{
+	PUSH_BACK,
+	PUSH_FRONT,
+	FIND,
+	REMOVE,
+	SEQUENTIAL_INDEX,
+	RANDOM_INDEX,
+	ITERATE,
+	COPY,
+	OPERATION_COUNT,
+};
+
+static const char* operationNames[OPERATION_COUNT] = { "pushBack", "pushFront", "find", "remove", "sequential []", "random []", "iterate", "copy" };
+
+// Past this size, calls that walk the container are skipped
+static const int walkLimit = 4096;
+// Lookups and removals done per measurement, they walk the container each
+static const int searches = 1024;
+
+/*
+	Nanoseconds per value (per lookup or removal for find and remove) of every operation, -1 where skipped.
+	walkingPushFront and walkingIndex tell which calls are linear for this container
+*/
+template <typename List>
+static std::vector<double> benchmarkList(const std::vector<Value>& values, const std::vector<int>& shuffled, bool walkingPushFront, bool walkingIndex, bool walkingRandomIndex)
+{
+	int size = (int)values.size();
+	int lookups = std::min(size, searches);
+	std::vector<double> nanoseconds(OPERATION_COUNT, -1.0);
+	auto perValue = [](double milliseconds, int count) { return milliseconds * 1e6 / count; };
+
+	nanoseconds[PUSH_BACK] = perValue(measure([&]() { List list; for (Value value : values) pushBack(list, value); }), size);
+	if (!walkingPushFront || size <= walkLimit)
+		nanoseconds[PUSH_FRONT] = perValue(measure([&]() { List list; for (Value value : values) pushFront(list, value); }), size);
+
+	List list;
+	for (Value value : values)
+		pushBack(list, value);
+
+	nanoseconds[FIND] = perValue(measure([&]()
+	{
+		size_t found = 0;
+		for (int i = 0; i < lookups; ++i)
+			found += contains(list, values[shuffled[i]]);
+		benchmarkSink = found;
+	}), lookups);
+
+	double copy = measure([&]() { List copied = list; benchmarkSink = (size_t)&copied; });
+	nanoseconds[COPY] = perValue(copy, size);
+
+	// Each removal needs a full list, so the copy is measured with it and taken out again
+	double removals = measure([&]()
+	{
+		List copied = list;
+		for (int i = 0; i < lookups; ++i)
+			removeValue(copied, values[shuffled[i]]);
+	});
+	nanoseconds[REMOVE] = perValue(std::max(0.0, removals - copy), lookups);
+
+	if (!walkingIndex || size <= walkLimit)
+	{
+		nanoseconds[SEQUENTIAL_INDEX] = perValue(measure([&]()
+		{
+			size_t sum = 0;
+			for (int i = 0; i < size; ++i)
+				sum += (size_t)at(list, i);
+			benchmarkSink = sum;
+		}), size);
+	}
+
+	if (!walkingRandomIndex || size <= walkLimit)
+	{
+		nanoseconds[RANDOM_INDEX] = perValue(measure([&]()
+		{
+			size_t sum = 0;
+			for (int i = 0; i < size; ++i)
+				sum += (size_t)at(list, shuffled[i]);
+			benchmarkSink = sum;
+		}), size);
+	}
+
+	nanoseconds[ITERATE] = perValue(measure([&]()
+	{
+		size_t sum = 0;
+		for (Value value : list)
+			sum += (size_t)value;
+		benchmarkSink = sum;
+	}), size);
+
+	return nanoseconds;
+}
+
+// One table per operation, a row per size and a column per container
+static void benchmarkContainers(std::ostream& output)
+{
+	const std::vector<std::string> containers = { "mf::LinkedList", "mf::UnrolledList", "std::vector", "std::list", "std::deque" };
+	const std::vector<int> sizes = { 16, 256, 4096, 65536 };
+	std::vector<std::vector<std::vector<double>>> results;
+
+	std::vector<int> pointed(sizes.back());
+	for (int size : sizes)
+	{
+		std::vector<Value> values(size);
+		std::vector<int> shuffled(size);
+		for (int i = 0; i < size; ++i)
+		{
+			values[i] = &pointed[i];
+			shuffled[i] = i;
+		}
+		std::mt19937 random(size);
+		std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+		// Linked lists walk to an index (mf::LinkedList only from the last one it visited), a vector moves everything to push in front
+		results.push_back({
+			benchmarkList<mf::LinkedList<Value>>(values, shuffled, false, false, true),
+			benchmarkList<mf::UnrolledList<Value>>(values, shuffled, false, false, false),
+			benchmarkList<std::vector<Value>>(values, shuffled, true, false, false),
+			benchmarkList<std::list<Value>>(values, shuffled, false, true, true),
+			benchmarkList<std::deque<Value>>(values, shuffled, false, false, false),
+		});
+	}
+
+	output << "Nanoseconds per value (per lookup for find and remove), - where it walks the container past " << walkLimit << " values" << std::endl;
+	for (int operation = 0; operation < OPERATION_COUNT; ++operation)
+	{
+		output << std::endl << std::left << std::setw(14) << operationNames[operation];
+		for (const std::string& container : containers)
+			output << std::right << std::setw(18) << container;
+		output << std::endl;
+
+		for (int i = 0; i < (int)sizes.size(); ++i)
+		{
+			output << std::left << std::setw(14) << sizes[i];
+			for (int container = 0; container < (int)containers.size(); ++container)
+			{
+				double nanoseconds = results[i][container][operation];
+				output << std::right << std::setw(18);
+				if (nanoseconds < 0)
+					output << "-";
+				else
+					output << std::fixed << std::setprecision(2) << nanoseconds;
+			}
+			output << std::endl;
+		}
+	}
+	output << std::endl << std::defaultfloat << std::setprecision(6);
+}
+
+// Two lists of size values in random order, sharing half of them
+template <typename DataType, typename Make>
+static void makeOverlapping(int size, Make make, mf::LinkedList<DataType>& list1, mf::LinkedList<DataType>& list2)
+{
+	std::vector<int> first(size), second(size);
+	for (int i = 0; i < size; ++i)
+	{
+		first[i] = i;
+		second[i] = i + size / 2;
+	}
+
+	std::mt19937 random(size);
+	std::shuffle(first.begin(), first.end(), random);
+	std::shuffle(second.begin(), second.end(), random);
+
+	for (int i = 0; i < size; ++i)
+	{
+		list1.pushBack(make(first[i]));
+		list2.pushBack(make(second[i]));
+	}
+}
+
+template <typename DataType, typename Make>
+static void benchmarkIntersection(std::ostream& output, std::string typeName, Make make)
+{
+	for (int size : { 8, 32, 128, 512, 2048, 8192 })
+	{
+		mf::LinkedList<DataType> list1, list2, intersection;
+		makeOverlapping(size, make, list1, list2);
+
+		double scan = measure([&]() { scanIntersection(list1, list2); });
+		double lookup = measure([&]() { mf::getIntersection(list1, list2, intersection); });
+
+		// What a std::vector caller would write
+		std::vector<DataType> vector1, vector2, vectorIntersection;
+		for (const DataType& value : list1)
+			vector1.push_back(value);
+		for (const DataType& value : list2)
+			vector2.push_back(value);
+		double standard = measure([&]()
+		{
+			std::unordered_set<DataType> lookupSet(vector2.begin(), vector2.end());
+			vectorIntersection.clear();
+			for (const DataType& value : vector1)
+				if (lookupSet.count(value) != 0)
+					vectorIntersection.push_back(value);
+		});
+
+		mf::LinkedList<DataType> expected = scanIntersection(list1, list2);
+		bool same = expected.getSize() == intersection.getSize();
+		for (int i = 0; same && i < expected.getSize(); ++i)
+			same = expected[i] == intersection[i];
+
+		output << "Intersection of " << size << " " << typeName << ": ";
+		output << "scan " << scan << " ms, ";
+		output << "getIntersection " << lookup << " ms, ";
+		output << "std::vector and std::unordered_set " << standard << " ms";
+		output << (same ? "" : " (DIFFERENT RESULT)") << std::endl;
+	}
+}
+
+int main()
+{
+	benchmarkContainers(std::cout);
+
+	std::vector<int> pointed(8192 * 2);
+
+	benchmarkIntersection<int*>(std::cout, "pointers", [&](int i) { return &pointed[i]; });
+	benchmarkIntersection<std::string>(std::cout, "strings", [](int i) { return "node" + std::to_string(i); });
+
+	return 0;
+}
@@ -0,0 +1,455 @@
+#include "NetlistParser.h"
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static bool isSeparator(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '(' || c == ')';
+}
+
+/*
+================= Public realization of class BasicNetlistParser =================
+*/
+
+template <typename Scalar>
+BasicNetlistParser<Scalar>::BasicNetlistParser(CircuitCore& circuit) : _circuit(circuit) { }
+
+template <typename Scalar>
+void BasicNetlistParser<Scalar>::parseFile(const std::string& path)
+{
+	Outcome outcome = tryParseFile(path);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+void BasicNetlistParser<Scalar>::parse(std::istream& input)
+{
+	Outcome outcome = tryParse(input);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+void BasicNetlistParser<Scalar>::parse(const char* text, size_t size)
+{
+	Outcome outcome = tryParse(text, size);
+	if (!outcome)
+		throw outcome.error;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::tryParseFile(const std::string& path)
+{
+#ifndef _WIN32
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+
+	struct stat info;
+	if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		size_t size = (size_t)info.st_size;
+		void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapped != MAP_FAILED)
+		{
+			close(file);
+			madvise(mapped, size, MADV_SEQUENTIAL);
+			Outcome outcome = tryParse((const char*)mapped, size);
+			munmap(mapped, size);
+			return outcome;
+		}
+	}
+	close(file);
+#endif
+
+	// Pipes, empty files and systems without mmap
+	std::ifstream input(path, std::ios::binary);
+	if (!input)
+		return Outcome::failure(CircuitBase::NETLIST_CANNOT_OPEN, path);
+	return tryParse(input);
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::tryParse(std::istream& input)
+{
+	_outcome = Outcome();
+	_finished = false;
+
+	// Statements are handled as soon as they are complete, what's left of the block moves to the front
+	std::vector<char> buffer(1 << 20);
+	size_t filled = 0;
+	while (true)
+	{
+		input.read(buffer.data() + filled, buffer.size() - filled);
+		filled += (size_t)input.gcount();
+		bool final = !input;
+
+		size_t used = consume(buffer.data(), filled, final);
+		if (!_outcome || _finished || final)
+			break;
+
+		filled -= used;
+		std::memmove(buffer.data(), buffer.data() + used, filled);
+
+		// A statement longer than the buffer
+		if (filled == buffer.size())
+			buffer.resize(buffer.size() * 2);
+	}
+
+	return _outcome;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::tryParse(const char* text, size_t size)
+{
+	_outcome = Outcome();
+	_finished = false;
+
+	// Nearly every line of a big netlist is an element, and there are usually about half as many nodes
+	long long lines = 0;
+	for (const char* cursor = text; (cursor = (const char*)std::memchr(cursor, '\n', text + size - cursor)) != nullptr; ++cursor)
+		++lines;
+	if (lines > 1024)
+		_circuit.reserve((int)lines, (int)(lines / 2));
+
+	consume(text, size, true);
+	return _outcome;
+}
+
+template <typename Scalar>
+long long BasicNetlistParser<Scalar>::getLine() const
+{
+	return _statementLine;
+}
+
+template <typename Scalar>
+long long BasicNetlistParser<Scalar>::getElementCount() const
+{
+	return _elementCount;
+}
+
+template <typename Scalar>
+BasicSubcircuit<Scalar>* BasicNetlistParser<Scalar>::searchSubcircuit(const std::string& name) const
+{
+	auto found = _subcircuits.find(name);
+	return found != _subcircuits.end() ? found->second.get() : nullptr;
+}
+
+/*
+================= Private realization of class BasicNetlistParser =================
+*/
+
+// Handles the complete statements in data and returns how much of it they took
+template <typename Scalar>
+size_t BasicNetlistParser<Scalar>::consume(const char* data, size_t size, bool final)
+{
+	size_t position = 0;
+	while (position < size && !_finished)
+	{
+		// A statement ends where a line that doesn't start with + begins
+		size_t end = position;
+		int lines = 0;
+		while (true)
+		{
+			const char* newline = (const char*)std::memchr(data + end, '\n', size - end);
+			if (newline == nullptr)
+			{
+				if (!final)
+					return position;
+				end = size;
+				break;
+			}
+
+			end = newline - data + 1;
+			++lines;
+			if (end == size)
+			{
+				if (!final)
+					return position;
+				break;
+			}
+			if (data[end] != '+')
+				break;
+		}
+
+		_statementLine = _line + 1;
+		tokenize(data + position, data + end);
+		Outcome outcome = statement();
+		_line += lines;
+		position = end;
+
+		if (!outcome)
+		{
+			_outcome = outcome;
+			return position;
+		}
+	}
+
+	return position;
+}
+
+template <typename Scalar>
+void BasicNetlistParser<Scalar>::tokenize(const char* begin, const char* end)
+{
+	_tokens.clear();
+
+	bool lineStart = true;
+	const char* cursor = begin;
+	while (cursor < end)
+	{
+		char c = *cursor;
+		if (c == '\n')
+		{
+			lineStart = true;
+			++cursor;
+			continue;
+		}
+
+		if (lineStart && c == '+')
+		{
+			lineStart = false;
+			++cursor;
+			continue;
+		}
+		lineStart = false;
+
+		if (c == ';')
+		{
+			while (cursor < end && *cursor != '\n')
+				++cursor;
+			continue;
+		}
+
+		if (isSeparator(c))
+		{
+			++cursor;
+			continue;
+		}
+
+		const char* start = cursor;
+		while (cursor < end && !isSeparator(*cursor) && *cursor != '\n' && *cursor != ';')
+			++cursor;
+		_tokens.push_back({ start, (size_t)(cursor - start) });
+	}
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::statement()
+{
+	if (_tokens.empty())
+		return Outcome();
+
+	char kind = (char)std::toupper((unsigned char)_tokens[0].text[0]);
+	if (kind == '*')
+		return Outcome();
+	if (kind == '.')
+		return directive();
+	if (kind == 'R' || kind == 'V' || kind == 'W')
+		return addElement(kind);
+	if (kind == 'X')
+		return addInstance();
+
+	return Outcome::failure(CircuitBase::NETLIST_UNSUPPORTED, text(0, _name));
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::directive()
+{
+	if (is(0, ".subckt"))
+	{
+		// Definitions can't be nested, but they can use the ones before them
+		if (_tokens.size() < 2 || _definition != nullptr)
+			return Outcome::failure(CircuitBase::NETLIST_SYNTAX, text(0, _name));
+
+		text(1, _name);
+		std::unique_ptr<Subcircuit>& subcircuit = _subcircuits[_name];
+		if (subcircuit != nullptr)
+			return Outcome::failure(CircuitBase::ELEMENT_ALREADY_EXIST, _name);
+
+		_nodes.clear();
+		for (size_t i = 2; i < _tokens.size(); ++i)
+			_nodes.emplaceBack(_tokens[i].text, _tokens[i].length);
+
+		subcircuit.reset(new Subcircuit(_name, _nodes));
+		_definition = subcircuit.get();
+	}
+	else if (is(0, ".ends"))
+	{
+		if (_definition == nullptr)
+			return Outcome::failure(CircuitBase::NETLIST_SYNTAX, text(0, _name));
+		_definition = nullptr;
+	}
+	else if (is(0, ".end"))
+	{
+		_finished = true;
+	}
+
+	return Outcome();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::addElement(char kind)
+{
+	size_t needed = kind == 'W' ? 3 : 4;
+	if (_tokens.size() < needed)
+		return Outcome::failure(CircuitBase::NETLIST_SYNTAX, text(0, _name));
+
+	text(0, _name);
+	text(1, _node1);
+	text(2, _node2);
+
+	double number = 0.0;
+	if (kind != 'W')
+	{
+		size_t index = kind == 'V' && is(3, "dc") ? 4 : 3;
+		if (index >= _tokens.size() || !value(_tokens[index], number))
+			return Outcome::failure(CircuitBase::NETLIST_SYNTAX, _name);
+	}
+
+	bool wire = kind == 'W' || (kind == 'R' && number == 0.0);
+
+	// The positive side of a SPICE source is its first node
+	if (_definition != nullptr)
+	{
+		try
+		{
+			if (wire)
+				_definition->addWire(_name, _node1, _node2);
+			else if (kind == 'V')
+				_definition->addBattery(_name, Scalar(number), _node2, _node1);
+			else
+				_definition->addResistor(_name, Scalar(number), _node1, _node2);
+		}
+		catch (CircuitBase::Errors error)
+		{
+			return Outcome::failure(error, _name);
+		}
+	}
+	else
+	{
+		Outcome outcome;
+		if (wire)
+			outcome = _circuit.tryAddWire(_name, _node1, _node2);
+		else if (kind == 'V')
+			outcome = _circuit.tryAddBattery(_name, Scalar(number), _node2, _node1);
+		else
+			outcome = _circuit.tryAddResistor(_name, Scalar(number), _node1, _node2);
+
+		if (!outcome)
+			return outcome;
+	}
+
+	++_elementCount;
+	return Outcome();
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicNetlistParser<Scalar>::addInstance()
+{
+	if (_tokens.size() < 3)
+		return Outcome::failure(CircuitBase::NETLIST_SYNTAX, text(0, _name));
+
+	text(0, _name);
+	Subcircuit* subcircuit = searchSubcircuit(text(_tokens.size() - 1, _node1));
+	if (subcircuit == nullptr || subcircuit == _definition)
+		return Outcome::failure(CircuitBase::NETLIST_UNKNOWN_SUBCIRCUIT, _name);
+
+	_nodes.clear();
+	for (size_t i = 1; i + 1 < _tokens.size(); ++i)
+		_nodes.emplaceBack(_tokens[i].text, _tokens[i].length);
+
+	if (_definition != nullptr)
+	{
+		try
+		{
+			_definition->addInstance(_name, *subcircuit, _nodes);
+		}
+		catch (CircuitBase::Errors error)
+		{
+			return Outcome::failure(error, _name);
+		}
+	}
+	else
+	{
+		Outcome outcome = _circuit.tryAddSubcircuit(_name, *subcircuit, _nodes);
+		if (!outcome)
+			return outcome;
+	}
+
+	++_elementCount;
+	return Outcome();
+}
+
+// A number with an optional SPICE suffix, 4.7k or 10meg
+template <typename Scalar>
+bool BasicNetlistParser<Scalar>::value(const Token& token, double& result) const
+{
+	const char* begin = token.text;
+	const char* end = token.text + token.length;
+	if (begin != end && *begin == '+')
+		++begin;
+
+	std::from_chars_result parsed = std::from_chars(begin, end, result);
+	if (parsed.ec != std::errc())
+		return false;
+
+	const char* suffix = parsed.ptr;
+	if (suffix == end)
+		return true;
+
+	// Whatever follows the suffix is a unit, like the Ohm of 10kOhm
+	switch (std::tolower((unsigned char)*suffix))
+	{
+	case 'f': result *= 1e-15; break;
+	case 'p': result *= 1e-12; break;
+	case 'n': result *= 1e-9; break;
+	case 'u': result *= 1e-6; break;
+	case 'k': result *= 1e3; break;
+	case 'g': result *= 1e9; break;
+	case 't': result *= 1e12; break;
+	case 'm':
+		if (end - suffix >= 3 && std::tolower((unsigned char)suffix[1]) == 'e' && std::tolower((unsigned char)suffix[2]) == 'g')
+			result *= 1e6;
+		else if (end - suffix >= 3 && std::tolower((unsigned char)suffix[1]) == 'i' && std::tolower((unsigned char)suffix[2]) == 'l')
+			result *= 25.4e-6;
+		else
+			result *= 1e-3;
+		break;
+	}
+	return true;
+}
+
+template <typename Scalar>
+const std::string& BasicNetlistParser<Scalar>::text(size_t index, std::string& target) const
+{
+	target.assign(_tokens[index].text, _tokens[index].length);
+	return target;
+}
+
+template <typename Scalar>
+bool BasicNetlistParser<Scalar>::is(size_t index, const char* word) const
+{
+	const Token& token = _tokens[index];
+	if (token.length != std::strlen(word))
+		return false;
+
+	for (size_t i = 0; i < token.length; ++i)
+		if (std::tolower((unsigned char)token.text[i]) != word[i])
+			return false;
+	return true;
+}
+
+template class BasicNetlistParser<float>;
+template class BasicNetlistParser<double>;
+template class BasicNetlistParser<long double>;
+template class BasicNetlistParser<std::complex<double>>;
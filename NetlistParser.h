@@ -0,0 +1,100 @@
+#ifndef MF_NETLIST_PARSER_DEF
+#define MF_NETLIST_PARSER_DEF
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mfLinkedList.h"
+#include "CircuitCore.h"
+#include "Subcircuit.h"
+
+/*
+	Reads a SPICE-style netlist into a circuit as it goes, without keeping the text:
+
+		* A divider
+		V1 in 0 DC 12
+		R1 in out 4.7k
+		.subckt Load top bottom
+		R1 top bottom 1meg
+		.ends
+		X1 out 0 Load
+		W1 0 gnd
+		.end
+
+	Rname a b value is a resistor from a to b (0 makes it a wire), Vname plus minus [DC] value
+	is a battery with its positive side on plus, and Wname a b is a wire (not in SPICE).
+	Values take the SPICE suffixes (f p n u m k meg g t mil), letters after them are ignored (10kOhm).
+	Lines starting with + continue the previous one, * starts a comment line and ; a comment till the end of the line.
+	.subckt / .ends define a Subcircuit, Xname nodes... subcircuit adds an instance of one defined above.
+	Other dot commands are skipped, and .end stops reading.
+*/
+template <typename Scalar>
+class BasicNetlistParser
+{
+	typedef BasicCircuitCore<Scalar> CircuitCore;
+	typedef BasicSubcircuit<Scalar> Subcircuit;
+	typedef CircuitBase::Outcome Outcome;
+
+public:
+	BasicNetlistParser(CircuitCore& circuit);
+
+	// Maps the file into memory where it can, reads it in blocks otherwise
+	void parseFile(const std::string& path);
+	void parse(std::istream& input);
+	void parse(const char* text, size_t size);
+
+	Outcome tryParseFile(const std::string& path);
+	Outcome tryParse(std::istream& input);
+	Outcome tryParse(const char* text, size_t size);
+
+	// Line of the statement that failed (or the last one read)
+	long long getLine() const;
+	long long getElementCount() const;
+	// Subcircuits defined so far, they live as long as the parser
+	Subcircuit* searchSubcircuit(const std::string& name) const;
+
+private:
+	BasicNetlistParser(const BasicNetlistParser& parser);
+	void operator = (const BasicNetlistParser& parser);
+
+	struct Token
+	{
+		const char* text;
+		size_t length;
+	};
+
+	size_t consume(const char* data, size_t size, bool final);
+	void tokenize(const char* begin, const char* end);
+	Outcome statement();
+	Outcome directive();
+	Outcome addElement(char kind);
+	Outcome addInstance();
+	bool value(const Token& token, double& result) const;
+	const std::string& text(size_t index, std::string& target) const;
+	bool is(size_t index, const char* word) const;
+
+private:
+	CircuitCore& _circuit;
+	Outcome _outcome;
+	bool _finished = false;
+	long long _line = 0;
+	long long _statementLine = 0;
+	long long _elementCount = 0;
+
+	// Reused for every statement, so reading doesn't allocate once they are big enough
+	std::vector<Token> _tokens;
+	std::string _name;
+	std::string _node1;
+	std::string _node2;
+	mf::LinkedList<std::string> _nodes;
+
+	std::unordered_map<std::string, std::unique_ptr<Subcircuit>> _subcircuits;
+	Subcircuit* _definition = nullptr;
+};
+
+typedef BasicNetlistParser<double> NetlistParser;
+
+#endif // MF_NETLIST_PARSER_DEF
@@ -0,0 +1,323 @@
+#include "ResultsWriter.h"
+#include <charconv>
+#include <cstring>
+
+// Bytes handed to the output at once, and binary rows per block
+static const size_t resultsChunk = 1 << 20;
+static const size_t resultsBlockRows = 1 << 14;
+static const size_t resultsAlignment = 16;
+
+static const char resultsMagic[8] = { 'N', 'C', 'S', 'R', 'E', 'S', '\r', '\n' };
+static const uint32_t resultsByteOrder = 0x01020304;
+
+enum ResultsBlock
+{
+	RESULTS_NAMES = 1,
+	RESULTS_ROWS = 2,
+};
+
+enum ResultsKind
+{
+	RESULTS_ELEMENT,
+	RESULTS_NODE,
+};
+
+// Shortest text that reads back as the same number
+template <typename Real>
+static void appendNumber(std::string& buffer, Real value)
+{
+	char text[64];
+	std::to_chars_result written = std::to_chars(text, text + sizeof(text), value);
+	buffer.append(text, written.ptr);
+}
+
+// 1.2-1.6j, so a phasor stays one CSV field
+template <typename Real>
+static void appendNumber(std::string& buffer, const std::complex<Real>& value)
+{
+	appendNumber(buffer, value.real());
+	if (!std::signbit(value.imag()))
+		buffer += '+';
+	appendNumber(buffer, value.imag());
+	buffer += 'j';
+}
+
+static void appendCsvText(std::string& buffer, const std::string& text)
+{
+	if (text.find_first_of(",\"\r\n") == std::string::npos)
+	{
+		buffer += text;
+		return;
+	}
+
+	buffer += '"';
+	for (char c : text)
+	{
+		if (c == '"')
+			buffer += '"';
+		buffer += c;
+	}
+	buffer += '"';
+}
+
+static void appendBytes(std::string& buffer, const void* data, size_t size)
+{
+	buffer.append((const char*)data, size);
+}
+
+// Everything written is padded, so the buffer stays aligned with the file
+static void appendPadding(std::string& buffer)
+{
+	buffer.append((resultsAlignment - buffer.size() % resultsAlignment) % resultsAlignment, '\0');
+}
+
+static void appendBlockHeader(std::string& buffer, uint32_t type, uint64_t count)
+{
+	uint32_t reserved = 0;
+	appendBytes(buffer, &type, sizeof(type));
+	appendBytes(buffer, &reserved, sizeof(reserved));
+	appendBytes(buffer, &count, sizeof(count));
+}
+
+/*
+================= Public realization of class BasicResultsWriter =================
+*/
+
+template <typename Scalar>
+BasicResultsWriter<Scalar>::BasicResultsWriter(std::ostream& output, Format format, bool background) : _output(output), _format(format), _background(background)
+{
+	_buffer.reserve(resultsChunk + resultsChunk / 4);
+
+	if (_format == CSV)
+		_buffer += "sample,kind,name,voltage,current,resistance\n";
+	else
+	{
+		uint32_t header[4] = { version, resultsByteOrder, ScalarTraits<Scalar>::fileType(), (uint32_t)sizeof(Scalar) };
+		appendBytes(_buffer, resultsMagic, sizeof(resultsMagic));
+		appendBytes(_buffer, header, sizeof(header));
+		appendPadding(_buffer);
+	}
+
+	if (_background)
+		_thread = std::thread(&BasicResultsWriter::run, this);
+}
+
+template <typename Scalar>
+BasicResultsWriter<Scalar>::~BasicResultsWriter()
+{
+	finish();
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::write(const CircuitCore& circuit, double sample)
+{
+	if (_finished)
+		return;
+
+	if (_format == CSV)
+		writeCsv(circuit, sample);
+	else
+		writeBinary(circuit, sample);
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::finish()
+{
+	if (_finished)
+		return;
+	_finished = true;
+
+	if (_format == BINARY)
+		encodeBlock();
+	flush();
+
+	if (_background)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_condition.notify_all();
+		_thread.join();
+	}
+
+	_output.flush();
+	if (!_output)
+		_good = false;
+}
+
+template <typename Scalar>
+bool BasicResultsWriter<Scalar>::good() const
+{
+	return _good;
+}
+
+/*
+================= Private realization of class BasicResultsWriter =================
+*/
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::writeCsv(const CircuitCore& circuit, double sample)
+{
+	// The sample is the same on every row, so it's formatted once
+	std::string prefix;
+	appendNumber(prefix, sample);
+
+	for (const BasicElementResult<Scalar>& result : circuit.getResults())
+	{
+		_buffer += prefix;
+		_buffer += ",element,";
+		appendCsvText(_buffer, circuit.getResultName(result.nameId));
+		_buffer += ',';
+		appendNumber(_buffer, result.voltage);
+		_buffer += ',';
+		appendNumber(_buffer, result.current);
+		_buffer += ',';
+		appendNumber(_buffer, result.resistance);
+		_buffer += '\n';
+
+		if (_buffer.size() >= resultsChunk)
+			flush();
+	}
+
+	for (const BasicNodeResult<Scalar>& result : circuit.getNodeResults())
+	{
+		_buffer += prefix;
+		_buffer += ",node,";
+		appendCsvText(_buffer, circuit.getNodeResultName(result.nameId));
+		_buffer += ',';
+		appendNumber(_buffer, result.potential);
+		_buffer += ",,\n";
+
+		if (_buffer.size() >= resultsChunk)
+			flush();
+	}
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::writeBinary(const CircuitCore& circuit, double sample)
+{
+	for (const BasicElementResult<Scalar>& result : circuit.getResults())
+		addRow(sample, circuit.getResultName(result.nameId), RESULTS_ELEMENT, result.voltage, result.current, result.resistance);
+
+	for (const BasicNodeResult<Scalar>& result : circuit.getNodeResults())
+		addRow(sample, circuit.getNodeResultName(result.nameId), RESULTS_NODE, result.potential, Scalar(0), Scalar(0));
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::addRow(double sample, const std::string& name, uint8_t kind, Scalar voltage, Scalar current, Scalar resistance)
+{
+	auto named = _names.try_emplace(name, (int32_t)_names.size());
+	if (named.second)
+		_newNames.push_back(name);
+
+	_voltages.push_back(voltage);
+	_currents.push_back(current);
+	_resistances.push_back(resistance);
+	_samples.push_back(sample);
+	_nameIds.push_back(named.first->second);
+	_kinds.push_back(kind);
+
+	if (_kinds.size() >= resultsBlockRows)
+		encodeBlock();
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::encodeBlock()
+{
+	// Names come before the rows that use them
+	if (!_newNames.empty())
+	{
+		appendBlockHeader(_buffer, RESULTS_NAMES, _newNames.size());
+		for (const std::string& name : _newNames)
+		{
+			uint32_t length = (uint32_t)name.size();
+			appendBytes(_buffer, &length, sizeof(length));
+		}
+		appendPadding(_buffer);
+		for (const std::string& name : _newNames)
+			_buffer += name;
+		appendPadding(_buffer);
+		_newNames.clear();
+	}
+
+	if (!_kinds.empty())
+	{
+		appendBlockHeader(_buffer, RESULTS_ROWS, _kinds.size());
+		appendBytes(_buffer, _voltages.data(), _voltages.size() * sizeof(Scalar));
+		appendPadding(_buffer);
+		appendBytes(_buffer, _currents.data(), _currents.size() * sizeof(Scalar));
+		appendPadding(_buffer);
+		appendBytes(_buffer, _resistances.data(), _resistances.size() * sizeof(Scalar));
+		appendPadding(_buffer);
+		appendBytes(_buffer, _samples.data(), _samples.size() * sizeof(double));
+		appendPadding(_buffer);
+		appendBytes(_buffer, _nameIds.data(), _nameIds.size() * sizeof(int32_t));
+		appendPadding(_buffer);
+		appendBytes(_buffer, _kinds.data(), _kinds.size());
+		appendPadding(_buffer);
+
+		_voltages.clear();
+		_currents.clear();
+		_resistances.clear();
+		_samples.clear();
+		_nameIds.clear();
+		_kinds.clear();
+	}
+
+	if (_buffer.size() >= resultsChunk)
+		flush();
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::flush()
+{
+	if (_buffer.empty())
+		return;
+
+	if (!_background)
+	{
+		_output.write(_buffer.data(), (std::streamsize)_buffer.size());
+		if (!_output)
+			_good = false;
+		_buffer.clear();
+		return;
+	}
+
+	// Hand the buffer over once the thread took the previous one, and keep filling its old one
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this]() { return _pending.empty(); });
+	_pending.swap(_buffer);
+	_condition.notify_all();
+}
+
+template <typename Scalar>
+void BasicResultsWriter<Scalar>::run()
+{
+	std::string writing;
+	writing.reserve(resultsChunk + resultsChunk / 4);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		_condition.wait(lock, [this]() { return !_pending.empty() || _stopping; });
+		if (_pending.empty())
+			break;
+
+		writing.swap(_pending);
+		_condition.notify_all();
+		lock.unlock();
+
+		_output.write(writing.data(), (std::streamsize)writing.size());
+		if (!_output)
+			_good = false;
+		writing.clear();
+
+		lock.lock();
+	}
+}
+
+template class BasicResultsWriter<float>;
+template class BasicResultsWriter<double>;
+template class BasicResultsWriter<long double>;
+template class BasicResultsWriter<std::complex<double>>;
@@ -0,0 +1,95 @@
+#ifndef MF_RESULTS_WRITER_DEF
+#define MF_RESULTS_WRITER_DEF
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CircuitCore.h"
+
+/*
+	Streams the results of solved circuits, one row per element and per node:
+
+		CSV     sample,kind,name,voltage,current,resistance (nodes only have a voltage, their potential)
+		BINARY  a header, then blocks of new names and blocks of rows stored column by column
+
+	Rows are formatted into a buffer with to_chars and written in big chunks. With background on,
+	a thread does the writing, so write() only formats. Each call to write() is one sample, like a
+	step of a sweep, and sample is written in every row to tell them apart.
+
+	The binary file starts with magic "NCSRES\r\n", version, byte order, scalar type and size (32 bytes).
+	Every block is a type (1 names, 2 rows), a count and columns padded to 16 bytes:
+	names are count lengths and then their text, numbered in the order they appear in the file,
+	rows are voltage, current and resistance (Scalar), sample (double), name (int32) and kind (uint8, 0 element, 1 node).
+*/
+template <typename Scalar>
+class BasicResultsWriter
+{
+	typedef BasicCircuitCore<Scalar> CircuitCore;
+
+public:
+	enum Format
+	{
+		CSV,
+		BINARY,
+	};
+
+	static const unsigned version = 1;
+
+	// output has to outlive the writer (or the call to finish)
+	BasicResultsWriter(std::ostream& output, Format format, bool background = false);
+	~BasicResultsWriter();
+
+	void write(const CircuitCore& circuit, double sample = 0.0);
+	// Writes what is left and stops the thread, nothing can be written after it
+	void finish();
+	// False once writing to the output failed
+	bool good() const;
+
+private:
+	BasicResultsWriter(const BasicResultsWriter& writer);
+	void operator = (const BasicResultsWriter& writer);
+
+	void writeCsv(const CircuitCore& circuit, double sample);
+	void writeBinary(const CircuitCore& circuit, double sample);
+	void addRow(double sample, const std::string& name, uint8_t kind, Scalar voltage, Scalar current, Scalar resistance);
+	void encodeBlock();
+	void flush();
+	void run();
+
+private:
+	std::ostream& _output;
+	Format _format;
+	bool _finished = false;
+	std::atomic<bool> _good{ true };
+
+	// Bytes waiting to be written, flushed once they reach a chunk
+	std::string _buffer;
+
+	// Binary rows not encoded yet, and names already given a number
+	std::unordered_map<std::string, int32_t> _names;
+	std::vector<std::string> _newNames;
+	std::vector<Scalar> _voltages;
+	std::vector<Scalar> _currents;
+	std::vector<Scalar> _resistances;
+	std::vector<double> _samples;
+	std::vector<int32_t> _nameIds;
+	std::vector<uint8_t> _kinds;
+
+	// Background writing, _pending is handed to the thread as a whole
+	bool _background = false;
+	bool _stopping = false;
+	std::string _pending;
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+};
+
+typedef BasicResultsWriter<double> ResultsWriter;
+
+#endif // MF_RESULTS_WRITER_DEF
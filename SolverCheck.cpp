@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "CircuitCore.h"
+#include "Subcircuit.h"
+
+/*
+	Solves circuits that need star-mesh transforms (bridges, random meshes, grids) with both solve()
+	and solveNodal(), and reports every element whose current or voltage differs between them.
+	Subcircuits from ohms to gigaohms are checked against the current they should draw too.
+	Run it after changing the reduction or the transforms, it exits with 1 if anything differs:
+
+		SolverCheck [seeds]     random meshes per size (20 by default)
+
+	Build it without the GUI:
+
+		g++ -O2 -o SolverCheck SolverCheck.cpp CircuitCore.cpp CircuitNodal.cpp CircuitOrdering.cpp Subcircuit.cpp CircuitCodeGen.cpp CircuitTrace.cpp -std=c++17
+*/
+
+typedef std::function<void(CircuitCore& circuit)> Builder;
+
+static std::string nodeName(int index)
+{
+	return "n" + std::to_string(index);
+}
+
+// A battery across a Wheatstone bridge, the smallest circuit without series or parallel elements
+static void bridge(CircuitCore& circuit)
+{
+	circuit.addBattery("V", 10, "bottom", "top");
+	circuit.addResistor("R1", 100, "top", "left");
+	circuit.addResistor("R2", 220, "top", "right");
+	circuit.addResistor("R3", 330, "left", "bottom");
+	circuit.addResistor("R4", 470, "right", "bottom");
+	circuit.addResistor("R5", 560, "left", "right");
+}
+
+// A ring of resistors through the nodes in random order, extra resistors between random pairs and a battery with an internal resistance
+static void randomMesh(CircuitCore& circuit, int nodes, int resistors, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::vector<std::vector<bool>> linked(nodes, std::vector<bool>(nodes, false));
+	auto link = [&](int a, int b, int index)
+	{
+		linked[a][b] = linked[b][a] = true;
+		circuit.addResistor("R" + std::to_string(index), 1 + random() % 1000, nodeName(a), nodeName(b));
+	};
+
+	circuit.addBattery("V", 10, nodeName(0), "source");
+	circuit.addResistor("Rs", 1 + random() % 10, "source", nodeName(nodes - 1));
+
+	std::vector<int> ring(nodes);
+	for (int i = 0; i < nodes; ++i)
+		ring[i] = i;
+	std::shuffle(ring.begin(), ring.end(), random);
+
+	int added = 0;
+	for (int i = 0; i < nodes; ++i)
+		link(ring[i], ring[(i + 1) % nodes], added++);
+	for (int tries = 0; added < resistors && tries < 100 * resistors; ++tries)
+	{
+		int a = (int)(random() % nodes);
+		int b = (int)(random() % nodes);
+		if (a != b && !linked[a][b])
+			link(a, b, added++);
+	}
+}
+
+// A square mesh of resistors with a battery from one corner to the other
+static void grid(CircuitCore& circuit, int side)
+{
+	auto at = [side](int row, int column) { return nodeName(row * side + column); };
+	circuit.addBattery("V", 10, at(side - 1, side - 1), at(0, 0));
+	for (int row = 0; row < side; ++row)
+	{
+		for (int column = 0; column < side; ++column)
+		{
+			std::string name = std::to_string(row) + "_" + std::to_string(column);
+			if (column + 1 < side)
+				circuit.addResistor("H" + name, 100 + (row + column) % 3, at(row, column), at(row, column + 1));
+			if (row + 1 < side)
+				circuit.addResistor("V" + name, 100 + (row * column) % 5, at(row, column), at(row + 1, column));
+		}
+	}
+}
+
+// The same resistance twice in parallel behind a battery, once as a subcircuit with an inner node, so the battery draws 20 / resistance
+static void highImpedance(CircuitCore& circuit, double resistance)
+{
+	mf::LinkedList<std::string> ports;
+	ports.pushBack("p");
+	ports.pushBack("q");
+	Subcircuit big("Big", ports);
+	big.addResistor("R1", resistance / 2, "p", "inner");
+	big.addResistor("R2", resistance / 2, "inner", "q");
+
+	mf::LinkedList<std::string> nodes;
+	nodes.pushBack("out");
+	nodes.pushBack("0");
+	circuit.addBattery("V", 10, "0", "out");
+	circuit.addSubcircuit("X1", big, nodes);
+	circuit.addResistor("R", resistance, "out", "0");
+}
+
+static bool close(double a, double b)
+{
+	return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+
+// Builds the circuit twice and compares the two solvers, only solveNodal failing counts as a mismatch
+static bool check(const std::string& name, const Builder& builder)
+{
+	CircuitCore reduced, nodal;
+	builder(reduced);
+	builder(nodal);
+
+	CircuitBase::Outcome expected = nodal.trySolveNodal();
+	CircuitBase::Outcome outcome = reduced.trySolve();
+	if (!expected)
+	{
+		std::cout << name << ": solveNodal failed with error " << expected.error << "\n";
+		return false;
+	}
+	if (!outcome)
+	{
+		std::cout << name << ": solve failed with error " << outcome.error << "\n";
+		return false;
+	}
+
+	bool same = true;
+	ResultView results = reduced.getResults();
+	ResultView nodalResults = nodal.getResults();
+	for (int i = 0; i < results.size(); ++i)
+	{
+		if (close(results[i].current, nodalResults[i].current) && close(results[i].voltage, nodalResults[i].voltage))
+			continue;
+
+		std::cout << name << ": " << reduced.getResultName(results[i].nameId) << " I " << results[i].current << " V " << results[i].voltage;
+		std::cout << ", solveNodal gives I " << nodalResults[i].current << " V " << nodalResults[i].voltage << "\n";
+		same = false;
+	}
+	return same;
+}
+
+// Both solvers have to agree and give the battery, the first element, this current
+static bool checkCurrent(const std::string& name, const Builder& builder, double expected)
+{
+	if (!check(name, builder))
+		return false;
+
+	CircuitCore circuit;
+	builder(circuit);
+	circuit.solveNodal();
+	double current = std::fabs(circuit.getResults()[0].current);
+	if (std::fabs(current - expected) <= 1e-6 * expected)
+		return true;
+
+	std::cout << name << ": the battery draws " << current << " instead of " << expected << "\n";
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	int seeds = argc > 1 ? std::atoi(argv[1]) : 20;
+	int checked = 0;
+	int failed = 0;
+	auto run = [&](const std::string& name, const Builder& builder)
+	{
+		++checked;
+		if (!check(name, builder))
+			++failed;
+	};
+
+	run("bridge", bridge);
+	for (int side = 2; side <= 8; ++side)
+		run("grid " + std::to_string(side), [side](CircuitCore& circuit) { grid(circuit, side); });
+
+	const char* resistances[] = { "1", "1e3", "1e6", "1e7", "1e9", "1e13" };
+	for (const char* text : resistances)
+	{
+		double resistance = std::atof(text);
+		++checked;
+		if (!checkCurrent("subcircuit " + std::string(text) + " ohm", [resistance](CircuitCore& circuit) { highImpedance(circuit, resistance); }, 20 / resistance))
+			++failed;
+	}
+
+	const int sizes[][2] = { { 5, 8 }, { 7, 15 }, { 12, 28 }, { 20, 45 } };
+	for (const auto& size : sizes)
+	{
+		for (int seed = 1; seed <= seeds; ++seed)
+		{
+			std::string name = "mesh " + std::to_string(size[0]) + "/" + std::to_string(size[1]) + " seed " + std::to_string(seed);
+			run(name, [&size, seed](CircuitCore& circuit) { randomMesh(circuit, size[0], size[1], seed); });
+		}
+	}
+
+	std::cout << checked << " circuits, " << failed << " differ" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
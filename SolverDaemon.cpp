@@ -0,0 +1,511 @@
+#include <iostream>
+
+/*
+	Keeps circuits in memory and solves them on request, over a Unix domain socket:
+
+		SolverDaemon [-j threads] [socket path, /tmp/NaiveCircuitSimulator.sock by default]
+
+	Requests are lines, every answer is one line starting with OK or ERROR (SOLVE adds the results after it):
+
+		LOAD bytes\n<netlist>       OK handle elements      the netlist is the next bytes (see NetlistParser)
+		ADD handle statement        OK                      one more netlist statement, like R5 a b 10k
+		SET handle element value    OK                      voltage of a battery or resistance of anything else
+		REMOVE handle element       OK
+		SOLVE handle                OK bytes\n<results>     results in the CSV format of ResultsWriter
+		FREE handle                 OK
+		STATS                       OK handles requests solves
+
+		ERROR code element node line    code is a CircuitBase::Errors, - where there is nothing to tell
+		ERROR message                   for requests it doesn't understand
+
+	A client can send many requests without waiting, they are answered in order. Requests of different
+	clients run at the same time on the thread pool.
+
+	Each handle keeps a circuit that is never solved (edits go there, and the subcircuits of its netlist
+	keep their reduced models), a saved image of it and the elimination order of its topology.
+	Solving loads the image into a new circuit and reuses the order, so changing a value costs
+	a load and a factorization, and only adding or removing elements orders the circuit again.
+	Build it (it needs a system with Unix domain sockets):
+
+		g++ -O2 -o SolverDaemon SolverDaemon.cpp CircuitCore.cpp CircuitNodal.cpp CircuitOrdering.cpp Subcircuit.cpp CircuitCodeGen.cpp CircuitTrace.cpp NetlistParser.cpp CircuitBinary.cpp ResultsWriter.cpp -lpthread -std=c++17
+*/
+
+#ifdef _WIN32
+
+int main()
+{
+	std::cerr << "SolverDaemon needs Unix domain sockets" << std::endl;
+	return 2;
+}
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "CircuitCore.h"
+#include "CircuitBinary.h"
+#include "CircuitOrdering.h"
+#include "NetlistParser.h"
+#include "ResultsWriter.h"
+
+static std::atomic<bool> daemonStopping{ false };
+
+static void stopDaemon(int)
+{
+	daemonStopping = true;
+}
+
+// A circuit kept between requests
+struct DaemonCircuit
+{
+	std::mutex mutex;
+	CircuitCore master;
+	NetlistParser parser{ master };
+	std::string image;
+	std::vector<int> order;
+	bool imageStale = true;
+	bool topologyChanged = true;
+};
+
+// A client, its requests are served one after another by whichever worker took it
+struct DaemonConnection
+{
+	DaemonConnection(int socket) : socket(socket) { }
+	~DaemonConnection() { close(socket); }
+
+	int socket;
+	std::string input;
+	std::mutex mutex;
+	std::deque<std::string> requests;
+	bool busy = false;
+};
+
+static std::string failure(const CircuitBase::Outcome& outcome, long long line = 0)
+{
+	std::string answer = "ERROR " + std::to_string(outcome.error);
+	answer += " " + (outcome.element.empty() ? std::string("-") : outcome.element);
+	answer += " " + (outcome.node.empty() ? std::string("-") : outcome.node);
+	answer += " " + std::to_string(line) + "\n";
+	return answer;
+}
+
+// Splits off the next word of text, starting at position
+static std::string nextWord(const std::string& text, size_t& position)
+{
+	while (position < text.size() && text[position] == ' ')
+		++position;
+	size_t start = position;
+	while (position < text.size() && text[position] != ' ')
+		++position;
+	return text.substr(start, position - start);
+}
+
+// A complete request at the front of input (LOAD carries its netlist after the line)
+static bool takeRequest(std::string& input, size_t& start, std::string& request)
+{
+	size_t end = input.find('\n', start);
+	if (end == std::string::npos)
+		return false;
+
+	size_t length = end - start;
+	if (input.compare(start, 5, "LOAD ") == 0)
+	{
+		unsigned long long bytes = 0;
+		std::from_chars(input.data() + start + 5, input.data() + end, bytes);
+		if (input.size() - end - 1 < bytes)
+			return false;
+		length = end + 1 + bytes - start;
+		request.assign(input, start, length);
+		start += length;
+		return true;
+	}
+
+	request.assign(input, start, length);
+	if (!request.empty() && request.back() == '\r')
+		request.pop_back();
+	start = end + 1;
+	return true;
+}
+
+static void sendAll(int socket, const std::string& data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t count = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (count <= 0)
+			return;
+		sent += (size_t)count;
+	}
+}
+
+class SolverDaemon
+{
+public:
+	SolverDaemon(int threads);
+	~SolverDaemon();
+
+	bool listen(const std::string& path);
+	// Serves until SIGINT or SIGTERM
+	void run();
+
+private:
+	void work();
+	void serve(const std::shared_ptr<DaemonConnection>& connection);
+	std::string answer(const std::string& request);
+	std::string load(const std::string& request);
+	std::string solve(const std::shared_ptr<DaemonCircuit>& circuit);
+	std::shared_ptr<DaemonCircuit> find(const std::string& handle);
+
+private:
+	int _listener = -1;
+	std::string _path;
+
+	std::vector<std::thread> _workers;
+	std::mutex _queueMutex;
+	std::condition_variable _queueCondition;
+	std::deque<std::shared_ptr<DaemonConnection>> _queue;
+	bool _stopping = false;
+
+	std::mutex _circuitsMutex;
+	std::unordered_map<long long, std::shared_ptr<DaemonCircuit>> _circuits;
+	long long _nextHandle = 1;
+
+	std::atomic<long long> _requests{ 0 };
+	std::atomic<long long> _solves{ 0 };
+};
+
+/*
+================= Public realization of class SolverDaemon =================
+*/
+
+SolverDaemon::SolverDaemon(int threads)
+{
+	for (int i = 0; i < threads; ++i)
+		_workers.emplace_back(&SolverDaemon::work, this);
+}
+
+SolverDaemon::~SolverDaemon()
+{
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_stopping = true;
+	}
+	_queueCondition.notify_all();
+	for (std::thread& worker : _workers)
+		worker.join();
+
+	if (_listener != -1)
+	{
+		close(_listener);
+		unlink(_path.c_str());
+	}
+}
+
+bool SolverDaemon::listen(const std::string& path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		return false;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	_listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (_listener == -1)
+		return false;
+
+	// A socket file left by a daemon that didn't stop cleanly
+	unlink(path.c_str());
+	if (bind(_listener, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(_listener, 64) != 0)
+	{
+		close(_listener);
+		_listener = -1;
+		return false;
+	}
+
+	_path = path;
+	return true;
+}
+
+void SolverDaemon::run()
+{
+	// Reading happens here, complete requests go to the workers
+	std::unordered_map<int, std::shared_ptr<DaemonConnection>> connections;
+	std::vector<pollfd> polled;
+	std::vector<char> buffer(1 << 16);
+
+	while (!daemonStopping)
+	{
+		polled.assign(1, pollfd{ _listener, POLLIN, 0 });
+		for (auto& connection : connections)
+			polled.push_back(pollfd{ connection.first, POLLIN, 0 });
+
+		// Wakes up now and then to notice a signal
+		if (poll(polled.data(), polled.size(), 200) <= 0)
+			continue;
+
+		if (polled[0].revents & POLLIN)
+		{
+			int client = accept4(_listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client != -1)
+				connections[client] = std::make_shared<DaemonConnection>(client);
+		}
+
+		for (size_t i = 1; i < polled.size(); ++i)
+		{
+			if (polled[i].revents == 0)
+				continue;
+
+			std::shared_ptr<DaemonConnection> connection = connections[polled[i].fd];
+			ssize_t count = recv(connection->socket, buffer.data(), buffer.size(), 0);
+			if (count <= 0)
+			{
+				// The worker still holding it closes the socket when it's done
+				connections.erase(polled[i].fd);
+				continue;
+			}
+
+			connection->input.append(buffer.data(), (size_t)count);
+			size_t start = 0;
+			std::string request;
+			bool schedule = false;
+			{
+				std::lock_guard<std::mutex> lock(connection->mutex);
+				while (takeRequest(connection->input, start, request))
+					connection->requests.push_back(std::move(request));
+				schedule = !connection->busy && !connection->requests.empty();
+				if (schedule)
+					connection->busy = true;
+			}
+			connection->input.erase(0, start);
+
+			if (schedule)
+			{
+				std::lock_guard<std::mutex> lock(_queueMutex);
+				_queue.push_back(connection);
+				_queueCondition.notify_one();
+			}
+		}
+	}
+}
+
+/*
+================= Private realization of class SolverDaemon =================
+*/
+
+void SolverDaemon::work()
+{
+	while (true)
+	{
+		std::shared_ptr<DaemonConnection> connection;
+		{
+			std::unique_lock<std::mutex> lock(_queueMutex);
+			_queueCondition.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+			if (_queue.empty())
+				return;
+			connection = std::move(_queue.front());
+			_queue.pop_front();
+		}
+
+		serve(connection);
+	}
+}
+
+void SolverDaemon::serve(const std::shared_ptr<DaemonConnection>& connection)
+{
+	// Answers go out in the order requests came in, so a client can pipeline them
+	while (true)
+	{
+		std::string request;
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			if (connection->requests.empty())
+			{
+				connection->busy = false;
+				return;
+			}
+			request = std::move(connection->requests.front());
+			connection->requests.pop_front();
+		}
+
+		sendAll(connection->socket, answer(request));
+	}
+}
+
+std::string SolverDaemon::answer(const std::string& request)
+{
+	++_requests;
+
+	size_t position = 0;
+	std::string command = nextWord(request, position);
+	if (command == "LOAD")
+		return load(request);
+
+	if (command == "STATS")
+	{
+		std::lock_guard<std::mutex> lock(_circuitsMutex);
+		return "OK " + std::to_string(_circuits.size()) + " " + std::to_string(_requests) + " " + std::to_string(_solves) + "\n";
+	}
+
+	std::string handle = nextWord(request, position);
+	std::shared_ptr<DaemonCircuit> circuit = find(handle);
+	if (circuit == nullptr)
+		return "ERROR unknown handle " + handle + "\n";
+
+	if (command == "SOLVE")
+		return solve(circuit);
+
+	if (command == "FREE")
+	{
+		std::lock_guard<std::mutex> lock(_circuitsMutex);
+		_circuits.erase(std::atoll(handle.c_str()));
+		return "OK\n";
+	}
+
+	std::lock_guard<std::mutex> lock(circuit->mutex);
+	CircuitBase::Outcome outcome;
+
+	if (command == "ADD")
+	{
+		std::string statement = request.substr(position) + "\n";
+		outcome = circuit->parser.tryParse(statement.data(), statement.size());
+		circuit->topologyChanged = true;
+	}
+	else if (command == "SET")
+	{
+		std::string element = nextWord(request, position);
+		std::string text = nextWord(request, position);
+		double value = 0.0;
+		std::from_chars_result parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size())
+			return "ERROR bad value " + text + "\n";
+		outcome = circuit->master.trySetValue(element, value);
+	}
+	else if (command == "REMOVE")
+	{
+		outcome = circuit->master.tryRemoveElement(nextWord(request, position));
+		circuit->topologyChanged = true;
+	}
+	else
+		return "ERROR unknown request " + command + "\n";
+
+	circuit->imageStale = true;
+	return outcome ? "OK\n" : failure(outcome);
+}
+
+std::string SolverDaemon::load(const std::string& request)
+{
+	size_t header = request.find('\n');
+	std::shared_ptr<DaemonCircuit> circuit = std::make_shared<DaemonCircuit>();
+
+	CircuitBase::Outcome outcome = circuit->parser.tryParse(request.data() + header + 1, request.size() - header - 1);
+	if (!outcome)
+		return failure(outcome, circuit->parser.getLine());
+
+	long long handle = 0;
+	{
+		std::lock_guard<std::mutex> lock(_circuitsMutex);
+		handle = _nextHandle++;
+		_circuits[handle] = circuit;
+	}
+	return "OK " + std::to_string(handle) + " " + std::to_string(circuit->parser.getElementCount()) + "\n";
+}
+
+std::string SolverDaemon::solve(const std::shared_ptr<DaemonCircuit>& circuit)
+{
+	CircuitCore solved;
+	std::vector<int> order;
+	{
+		// Edits may come in while this solves, the copy is all it needs
+		std::lock_guard<std::mutex> lock(circuit->mutex);
+		if (circuit->imageStale)
+		{
+			AutoOrdering automatic;
+			CircuitBase::Outcome saved = CircuitBinary::trySaveImage(circuit->master, circuit->image, circuit->topologyChanged ? &automatic : nullptr);
+			if (!saved)
+				return failure(saved);
+			circuit->imageStale = false;
+		}
+
+		CircuitBase::Outcome loaded = CircuitBinary::tryLoadImage(solved, circuit->image.data(), circuit->image.size(), &order);
+		if (!loaded)
+			return failure(loaded);
+
+		if (circuit->topologyChanged)
+		{
+			circuit->order = order;
+			circuit->topologyChanged = false;
+		}
+		else
+			order = circuit->order;
+	}
+
+	StoredOrdering stored(order);
+	CircuitBase::Outcome outcome = solved.trySolveNodal(&stored);
+	if (!outcome)
+		return failure(outcome);
+	++_solves;
+
+	std::ostringstream results;
+	{
+		ResultsWriter writer(results, ResultsWriter::CSV);
+		writer.write(solved);
+	}
+	std::string text = results.str();
+	return "OK " + std::to_string(text.size()) + "\n" + text;
+}
+
+std::shared_ptr<DaemonCircuit> SolverDaemon::find(const std::string& handle)
+{
+	std::lock_guard<std::mutex> lock(_circuitsMutex);
+	auto found = _circuits.find(std::atoll(handle.c_str()));
+	return found != _circuits.end() ? found->second : nullptr;
+}
+
+int main(int argc, char** argv)
+{
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string path = "/tmp/NaiveCircuitSimulator.sock";
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "-j" && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else
+			path = argument;
+	}
+
+	std::signal(SIGINT, stopDaemon);
+	std::signal(SIGTERM, stopDaemon);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	SolverDaemon daemon(threads);
+	if (!daemon.listen(path))
+	{
+		std::cerr << "Cannot listen on " << path << std::endl;
+		return 2;
+	}
+
+	std::cerr << "Listening on " << path << " with " << threads << " threads" << std::endl;
+	daemon.run();
+	return 0;
+}
+
+#endif
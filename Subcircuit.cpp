@@ -0,0 +1,101 @@
+#include "Subcircuit.h"
+
+/*
+================= Public realization of class BasicSubcircuit =================
+*/
+
+template <typename Scalar>
+BasicSubcircuit<Scalar>::BasicSubcircuit(std::string name, const mf::LinkedList<std::string>& ports) : _name(name), _ports(ports)
+{
+	_circuit = new BasicCircuitCore<Scalar>();
+}
+
+template <typename Scalar>
+BasicSubcircuit<Scalar>::~BasicSubcircuit()
+{
+	delete _circuit;
+}
+
+template <typename Scalar>
+BasicElement<Scalar>* BasicSubcircuit<Scalar>::addWire(std::string name, std::string negativeSide, std::string positiveSide)
+{
+	isAnalysed = false;
+	return _circuit->addWire(name, negativeSide, positiveSide);
+}
+
+template <typename Scalar>
+BasicElement<Scalar>* BasicSubcircuit<Scalar>::addResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide)
+{
+	isAnalysed = false;
+	return _circuit->addResistor(name, resistance, negativeSide, positiveSide);
+}
+
+template <typename Scalar>
+BasicElement<Scalar>* BasicSubcircuit<Scalar>::addBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide)
+{
+	isAnalysed = false;
+	return _circuit->addBattery(name, voltage, negativeSide, positiveSide);
+}
+
+template <typename Scalar>
+void BasicSubcircuit<Scalar>::addInstance(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes)
+{
+	isAnalysed = false;
+	_circuit->addSubcircuit(name, definition, nodes);
+}
+
+template <typename Scalar>
+std::string BasicSubcircuit<Scalar>::getName() const
+{
+	return _name;
+}
+
+template <typename Scalar>
+int BasicSubcircuit<Scalar>::getPortCount() const
+{
+	return _ports.getSize();
+}
+
+template <typename Scalar>
+const mf::LinkedList<std::string>& BasicSubcircuit<Scalar>::getPorts() const
+{
+	return _ports;
+}
+
+template <typename Scalar>
+const BasicPortModel<Scalar>& BasicSubcircuit<Scalar>::getModel()
+{
+	const PortModel* model = nullptr;
+	CircuitBase::Outcome status = tryGetModel(model);
+	if (!status)
+		throw status.error;
+
+	return *model;
+}
+
+template <typename Scalar>
+CircuitBase::Outcome BasicSubcircuit<Scalar>::tryGetModel(const PortModel*& model)
+{
+	// Changing the block after this only affects the instances added later
+	if (!isAnalysed)
+	{
+		CircuitBase::Outcome status = _circuit->tryReducePorts(_ports, _model);
+		if (!status)
+			return status;
+		isAnalysed = true;
+	}
+
+	model = &_model;
+	return CircuitBase::Outcome();
+}
+
+template <typename Scalar>
+bool BasicSubcircuit<Scalar>::analysed() const
+{
+	return isAnalysed;
+}
+
+template class BasicSubcircuit<float>;
+template class BasicSubcircuit<double>;
+template class BasicSubcircuit<long double>;
+template class BasicSubcircuit<std::complex<double>>;
@@ -0,0 +1,48 @@
+#ifndef MF_SUBCIRCUIT_DEF
+#define MF_SUBCIRCUIT_DEF
+
+#include <string>
+#include "mfLinkedList.h"
+#include "CircuitCore.h"
+
+/*
+	A reusable block with a few ports, like a voltage divider.
+	The block is analysed and port-reduced only once, every instance
+	attached to a circuit uses the same cached PortModel
+*/
+template <typename Scalar>
+class BasicSubcircuit
+{
+	typedef BasicElement<Scalar> Element;
+	typedef BasicPortModel<Scalar> PortModel;
+	typedef BasicSubcircuit<Scalar> Subcircuit;
+
+public:
+	BasicSubcircuit(std::string name, const mf::LinkedList<std::string>& ports);
+	~BasicSubcircuit();
+
+	Element* addWire(std::string name, std::string negativeSide, std::string positiveSide);
+	Element* addResistor(std::string name, Scalar resistance, std::string negativeSide, std::string positiveSide);
+	Element* addBattery(std::string name, Scalar voltage, std::string negativeSide, std::string positiveSide);
+	void addInstance(std::string name, Subcircuit& definition, const mf::LinkedList<std::string>& nodes);
+
+	std::string getName() const;
+	int getPortCount() const;
+	const mf::LinkedList<std::string>& getPorts() const;
+	const PortModel& getModel();
+	CircuitBase::Outcome tryGetModel(const PortModel*& model);
+	bool analysed() const;
+
+private:
+	BasicSubcircuit(const Subcircuit& subcircuit);
+	void operator = (const Subcircuit& subcircuit);
+
+private:
+	std::string _name;
+	mf::LinkedList<std::string> _ports;
+	BasicCircuitCore<Scalar>* _circuit = nullptr;
+	PortModel _model;
+	bool isAnalysed = false;
+};
+
+#endif // MF_SUBCIRCUIT_DEF
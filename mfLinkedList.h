@@ -2,6 +2,15 @@
 #ifndef LINKEDLIST_H
 #define LINKEDLIST_H
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 namespace mf
 {
 	template <typename DataType>
@@ -17,9 +26,12 @@ namespace mf
 
 		ListNode<DataType>* next;
 
+		ListNode<DataType>* prev;
+
 		ListNode();
 
-		ListNode(DataType data, ListNode<DataType>* next);
+		template <typename... Args>
+		ListNode(ListNode<DataType>* prev, ListNode<DataType>* next, Args&&... args);
 
 	public:
 
@@ -27,6 +39,8 @@ namespace mf
 
 		ListNode<DataType>* getNext() const;
 
+		ListNode<DataType>* getPrev() const;
+
 	};
 
 
@@ -59,21 +73,48 @@ namespace mf
 
 		ListNode<DataType>* lastListNode = head;
 
+		// Storage of erased nodes, reused by the next pushes instead of asking the allocator again
+		struct FreeNode
+		{
+			FreeNode* next;
+		};
+
+		FreeNode* freeNodes = nullptr;
+
+		template <typename... Args>
+		ListNode<DataType>* createNode(ListNode<DataType>* prev, ListNode<DataType>* next, Args&&... args);
+
+		void recycleNode(ListNode<DataType>* node);
+
+		void releaseFreeNodes();
+
 	public:
 
 		LinkedList();
 
 		LinkedList(const LinkedList<DataType>& linkedlist);
 
+		LinkedList(LinkedList<DataType>&& linkedlist);
+
 		int getSize() const;
 
+		// Heap memory of the nodes, the erased ones kept for reuse too
+		std::size_t getBytes() const;
+
 		ListNode<DataType>* getHead() const;
 
 		ListNode<DataType>* getTail() const;
 
-		void pushFront(const DataType& data);
+		// The returned node stays valid until it is removed, keep it to erase in O(1)
+		ListNode<DataType>* pushFront(const DataType& data);
 
-		void pushBack(const DataType& data);
+		ListNode<DataType>* pushBack(const DataType& data);
+
+		template <typename... Args>
+		ListNode<DataType>* emplaceFront(Args&&... args);
+
+		template <typename... Args>
+		ListNode<DataType>* emplaceBack(Args&&... args);
 
 		DataType* find(const DataType& data) const;
 
@@ -81,6 +122,9 @@ namespace mf
 
 		void remove(const DataType& data);
 
+		// The node must belong to this list
+		void erase(ListNode<DataType>* node);
+
 		Iterator begin() const
 		{
 			return Iterator(head);
@@ -99,8 +143,14 @@ namespace mf
 
 		void operator - (LinkedList<DataType>& list);
 
-		void operator = (const LinkedList<DataType>& list);
+		LinkedList<DataType>& operator = (const LinkedList<DataType>& list);
 
+		LinkedList<DataType>& operator = (LinkedList<DataType>&& list);
+
+		// Removes everything but keeps the nodes for reuse
+		void clear();
+
+		// Removes everything and gives the nodes back to the allocator
 		void destroy();
 
 		~LinkedList();
@@ -110,7 +160,8 @@ namespace mf
 	ListNode<DataType>::ListNode() {}
 
 	template <typename DataType>
-	ListNode<DataType>::ListNode(DataType data, ListNode<DataType>* next) : data(data), next(next){}
+	template <typename... Args>
+	ListNode<DataType>::ListNode(ListNode<DataType>* prev, ListNode<DataType>* next, Args&&... args) : data(std::forward<Args>(args)...), next(next), prev(prev){}
 
 	template <typename DataType>
 	DataType& ListNode<DataType>::getData()
@@ -124,6 +175,57 @@ namespace mf
 		return next;
 	}
 
+	template <typename DataType>
+	ListNode<DataType>* ListNode<DataType>::getPrev() const
+	{
+		return prev;
+	}
+
+	template <typename DataType>
+	template <typename... Args>
+	ListNode<DataType>* LinkedList<DataType>::createNode(ListNode<DataType>* prev, ListNode<DataType>* next, Args&&... args)
+	{
+		void* memory = freeNodes;
+
+		if (memory != nullptr)
+		{
+			freeNodes = freeNodes->next;
+		}
+		else
+		{
+			memory = ::operator new(sizeof(ListNode<DataType>));
+		}
+
+		try
+		{
+			return new (memory) ListNode<DataType>(prev, next, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			freeNodes = new (memory) FreeNode{ freeNodes };
+			throw;
+		}
+	}
+
+	template <typename DataType>
+	void LinkedList<DataType>::recycleNode(ListNode<DataType>* node)
+	{
+		node->~ListNode<DataType>();
+
+		freeNodes = new (node) FreeNode{ freeNodes };
+	}
+
+	template <typename DataType>
+	void LinkedList<DataType>::releaseFreeNodes()
+	{
+		while (freeNodes != nullptr)
+		{
+			FreeNode* next = freeNodes->next;
+			::operator delete(freeNodes);
+			freeNodes = next;
+		}
+	}
+
 	template <typename DataType>
 	LinkedList<DataType>::LinkedList() {}
 
@@ -141,12 +243,31 @@ namespace mf
 		}
 	}
 
+	template <typename DataType>
+	LinkedList<DataType>::LinkedList(LinkedList<DataType>&& linkedlist)
+	{
+		*this = std::move(linkedlist);
+	}
+
 	template <typename DataType>
 	int LinkedList<DataType>::getSize() const
 	{
 		return size;
 	}
 
+	template <typename DataType>
+	std::size_t LinkedList<DataType>::getBytes() const
+	{
+		std::size_t nodes = size;
+
+		for (FreeNode* node = freeNodes; node != nullptr; node = node->next)
+		{
+			++nodes;
+		}
+
+		return nodes * sizeof(ListNode<DataType>);
+	}
+
 	template <typename DataType>
 	ListNode<DataType>* LinkedList<DataType>::getHead() const
 	{
@@ -160,31 +281,53 @@ namespace mf
 	}
 
 	template <typename DataType>
-	void LinkedList<DataType>::pushFront(const DataType& data)
+	ListNode<DataType>* LinkedList<DataType>::pushFront(const DataType& data)
+	{
+		return emplaceFront(data);
+	}
+
+	template <typename DataType>
+	ListNode<DataType>* LinkedList<DataType>::pushBack(const DataType& data)
+	{
+		return emplaceBack(data);
+	}
+
+	template <typename DataType>
+	template <typename... Args>
+	ListNode<DataType>* LinkedList<DataType>::emplaceFront(Args&&... args)
 	{
-		ListNode<DataType>* node = new ListNode<DataType>(data, head);
+		ListNode<DataType>* node = createNode(nullptr, head, std::forward<Args>(args)...);
 
 		if (size == 0)
 		{
 			tail = node;
 		}
+		else
+		{
+			head->prev = node;
+		}
 
 		head = node;
 
 		size++;
+
+		// The cached index moved by one
+		lastListNode = head;
+		lastListNodeIndex = 0;
+
+		return node;
 	}
 
 	template <typename DataType>
-	void LinkedList<DataType>::pushBack(const DataType& data)
+	template <typename... Args>
+	ListNode<DataType>* LinkedList<DataType>::emplaceBack(Args&&... args)
 	{
 		if (size == 0)
 		{
-			pushFront(data);
-
-			return;
+			return emplaceFront(std::forward<Args>(args)...);
 		}
 
-		ListNode<DataType>* node = new ListNode<DataType>(data, nullptr);
+		ListNode<DataType>* node = createNode(tail, nullptr, std::forward<Args>(args)...);
 
 		tail->next = node;
 
@@ -192,7 +335,7 @@ namespace mf
 
 		size++;
 
-		return;
+		return node;
 	}
 
 	template <typename DataType>
@@ -221,18 +364,7 @@ namespace mf
 			return false;
 		}
 
-		if (size == 1)
-		{
-			tail = nullptr;
-		}
-
-		ListNode<DataType>* temp = head;
-
-		head = head->next;
-
-		delete temp;
-
-		size--;
+		erase(head);
 
 		return true;
 	}
@@ -240,53 +372,44 @@ namespace mf
 	template <typename DataType>
 	void LinkedList<DataType>::remove(const DataType& data)
 	{
-		ListNode<DataType>* cur = head ;
-
 		if (size == 0)
 		{
 			throw "List is empty";
 		}
 
-		if (head->data == data)
+		for (ListNode<DataType>* node = head; node != nullptr; node = node->next)
 		{
-			head = head->next;
-			delete cur;
-			size--;
-			lastListNode = head;
-			lastListNodeIndex = 0;
-
-			if (size == 0)
+			if (node->data == data)
 			{
-				tail = nullptr;
-			}
-
-			return;
-		}
+				erase(node);
 
-		while (true)
-		{
-			if (cur->next == nullptr)
-			{
 				return;
 			}
-
-			if (cur->next->data == data)
-			{
-				break;
-			}
-
-			cur = cur->next;
 		}
+	}
 
-		if (tail->data == data)
+	template <typename DataType>
+	void LinkedList<DataType>::erase(ListNode<DataType>* node)
+	{
+		if (node->prev != nullptr)
+		{
+			node->prev->next = node->next;
+		}
+		else
 		{
-			tail = cur;
+			head = node->next;
 		}
 
-		ListNode<DataType>* toRemove = cur->next;
+		if (node->next != nullptr)
+		{
+			node->next->prev = node->prev;
+		}
+		else
+		{
+			tail = node->prev;
+		}
 
-		cur->next = toRemove->next;
-		delete toRemove;
+		recycleNode(node);
 		size--;
 		lastListNode = head;
 		lastListNodeIndex = 0;
@@ -366,20 +489,93 @@ namespace mf
 	}
 
 	template <typename DataType>
-	void LinkedList<DataType>::operator = (const LinkedList<DataType>& list)
+	LinkedList<DataType>& LinkedList<DataType>::operator = (const LinkedList<DataType>& list)
 	{
-		destroy();
-		*this + (list);
+		if (this == &list)
+		{
+			return *this;
+		}
+
+		// Overwrite the nodes we already have, then grow or shrink
+		ListNode<DataType>* node = head;
+		ListNode<DataType>* source = list.head;
+
+		while (node != nullptr && source != nullptr)
+		{
+			node->data = source->data;
+			node = node->next;
+			source = source->next;
+		}
+
+		while (node != nullptr)
+		{
+			ListNode<DataType>* next = node->next;
+			erase(node);
+			node = next;
+		}
+
+		for (; source != nullptr; source = source->next)
+		{
+			pushBack(source->data);
+		}
+
+		lastListNode = head;
+		lastListNodeIndex = 0;
+
+		return *this;
 	}
 
+	template <typename DataType>
+	LinkedList<DataType>& LinkedList<DataType>::operator = (LinkedList<DataType>&& list)
+	{
+		if (this == &list)
+		{
+			return *this;
+		}
+
+		destroy();
+
+		head = list.head;
+		tail = list.tail;
+		size = list.size;
+		freeNodes = list.freeNodes;
+		lastListNode = head;
+		lastListNodeIndex = 0;
+
+		list.head = nullptr;
+		list.tail = nullptr;
+		list.size = 0;
+		list.freeNodes = nullptr;
+		list.lastListNode = nullptr;
+		list.lastListNodeIndex = 0;
+
+		return *this;
+	}
 
 	template <typename DataType>
-	void LinkedList<DataType>::destroy()
+	void LinkedList<DataType>::clear()
 	{
-		while (size != 0)
+		ListNode<DataType>* node = head;
+
+		while (node != nullptr)
 		{
-			remove(head->data);
+			ListNode<DataType>* next = node->next;
+			recycleNode(node);
+			node = next;
 		}
+
+		head = nullptr;
+		tail = nullptr;
+		size = 0;
+		lastListNode = nullptr;
+		lastListNodeIndex = 0;
+	}
+
+	template <typename DataType>
+	void LinkedList<DataType>::destroy()
+	{
+		clear();
+		releaseFreeNodes();
 	}
 
 	template <typename DataType>
@@ -389,18 +585,105 @@ namespace mf
 	}
 	
 
+	// Below this many pairs (size of list1 * size of list2) a plain scan beats building a lookup
+	constexpr long long intersectionScanLimit = 1024;
+
+	template <typename DataType, typename = void>
+	struct IsHashable : std::false_type {};
+
 	template <typename DataType>
-	LinkedList<DataType> getIntersection(const LinkedList<DataType>& list1, const LinkedList<DataType>& list2)
+	struct IsHashable<DataType, decltype((void)std::hash<DataType>()(std::declval<const DataType&>()))> : std::true_type {};
+
+	template <typename DataType, typename = void>
+	struct IsOrdered : std::false_type {};
+
+	template <typename DataType>
+	struct IsOrdered<DataType, decltype((void)(std::declval<const DataType&>() < std::declval<const DataType&>()))> : std::true_type {};
+
+	/*
+		Everything of list1 that is also in list2, in the order of list1, written into intersection.
+		Large lists are looked up in a hash set of list2, or in a sorted copy of it
+		when the values can't be hashed, instead of scanning list2 for every value
+	*/
+	template <typename DataType>
+	void getIntersection(const LinkedList<DataType>& list1, const LinkedList<DataType>& list2, LinkedList<DataType>& intersection)
 	{
-		LinkedList<DataType> intersection;
+		if (&intersection == &list1 || &intersection == &list2)
+		{
+			LinkedList<DataType> result;
+			getIntersection(list1, list2, result);
+			intersection = std::move(result);
+			return;
+		}
 
-		for (DataType& cur : list1)
+		intersection.clear();
+
+		if ((long long)list1.getSize() * list2.getSize() <= intersectionScanLimit)
 		{
-			if (list2.find(cur) != nullptr)
+			for (DataType& cur : list1)
 			{
-				intersection.pushBack(cur);
+				if (list2.find(cur) != nullptr)
+				{
+					intersection.pushBack(cur);
+				}
 			}
 		}
+		else if constexpr (IsHashable<DataType>::value)
+		{
+			std::unordered_set<DataType> lookup;
+			lookup.reserve(list2.getSize());
+
+			for (DataType& cur : list2)
+			{
+				lookup.insert(cur);
+			}
+
+			for (DataType& cur : list1)
+			{
+				if (lookup.count(cur) != 0)
+				{
+					intersection.pushBack(cur);
+				}
+			}
+		}
+		else if constexpr (IsOrdered<DataType>::value)
+		{
+			std::vector<DataType> lookup;
+			lookup.reserve(list2.getSize());
+
+			for (DataType& cur : list2)
+			{
+				lookup.push_back(cur);
+			}
+
+			std::sort(lookup.begin(), lookup.end());
+
+			for (DataType& cur : list1)
+			{
+				if (std::binary_search(lookup.begin(), lookup.end(), cur))
+				{
+					intersection.pushBack(cur);
+				}
+			}
+		}
+		else
+		{
+			for (DataType& cur : list1)
+			{
+				if (list2.find(cur) != nullptr)
+				{
+					intersection.pushBack(cur);
+				}
+			}
+		}
+	}
+
+	template <typename DataType>
+	LinkedList<DataType> getIntersection(const LinkedList<DataType>& list1, const LinkedList<DataType>& list2)
+	{
+		LinkedList<DataType> intersection;
+
+		getIntersection(list1, list2, intersection);
 
 		return intersection;
 	}
@@ -0,0 +1,677 @@
+#pragma once
+#ifndef UNROLLEDLIST_H
+#define UNROLLEDLIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace mf
+{
+	/*
+		A list that keeps its values in blocks of a few cache lines instead of one node per value.
+		Values never move once pushed: iterators stay valid until their own value is erased,
+		and erasing leaves a hole in its block instead of shifting the others.
+		operator [] finds the block through a directory of block positions that is rebuilt
+		lazily after pushes and erases, so indexing between changes doesn't walk the list.
+	*/
+	template <typename DataType>
+	class UnrolledList
+	{
+	public:
+
+		static constexpr int blockBytes = 4 * 64;
+
+		// At most 64, one bit per slot
+		static constexpr int blockCapacity = sizeof(DataType) >= blockBytes ? 1 : (blockBytes / sizeof(DataType) > 64 ? 64 : (int)(blockBytes / sizeof(DataType)));
+
+	private:
+
+		struct alignas(64) Block
+		{
+			Block* next = nullptr;
+
+			Block* prev = nullptr;
+
+			std::uint64_t used = 0;
+
+			// Slots in [first, end) have values or holes, first and end - 1 always have values
+			int first = 0;
+
+			int end = 0;
+
+			int count = 0;
+
+			// Position in the directory and index of the first value, valid after refresh
+			int index = 0;
+
+			int start = 0;
+
+			alignas(DataType) unsigned char storage[blockCapacity * sizeof(DataType)];
+
+			DataType* slot(int i)
+			{
+				return std::launder(reinterpret_cast<DataType*>(storage) + i);
+			}
+
+			bool isUsed(int i) const
+			{
+				return (used >> i) & 1;
+			}
+		};
+
+	public:
+
+		class Iterator
+		{
+			friend class UnrolledList<DataType>;
+
+		private:
+			Block* block = nullptr;
+			int slot = 0;
+
+		public:
+			Iterator() {}
+			Iterator(Block* block, int slot) : block(block), slot(slot) {}
+			void operator++();
+			bool operator!=(const Iterator& other) const { return block != other.block || slot != other.slot; }
+			bool operator==(const Iterator& other) const { return !(*this != other); }
+			DataType& operator*() const { return *block->slot(slot); }
+		};
+
+	protected:
+
+		Block* head = nullptr;
+
+		Block* tail = nullptr;
+
+		int size = 0;
+
+		// One emptied block is kept, so pushing and popping around a block boundary doesn't allocate
+		Block* spare = nullptr;
+
+		mutable std::vector<Block*> directory;
+
+		mutable bool directoryStale = true;
+
+		// Blocks from here on have a wrong start
+		mutable int staleFrom = 0;
+
+		mutable Block* lastBlock = nullptr;
+
+		Block* createBlock();
+
+		void releaseBlock(Block* block);
+
+		void changedCount(Block* block);
+
+		void refresh() const;
+
+		DataType* locate(int index) const;
+
+	public:
+
+		UnrolledList();
+
+		UnrolledList(const UnrolledList<DataType>& list);
+
+		UnrolledList(UnrolledList<DataType>&& list);
+
+		int getSize() const;
+
+		// Heap memory of the blocks, the spare one too, and of the directory
+		std::size_t getBytes() const;
+
+		// The returned iterator stays valid until its value is removed, keep it to erase in O(1)
+		Iterator pushFront(const DataType& data);
+
+		Iterator pushBack(const DataType& data);
+
+		template <typename... Args>
+		Iterator emplaceFront(Args&&... args);
+
+		template <typename... Args>
+		Iterator emplaceBack(Args&&... args);
+
+		DataType* find(const DataType& data) const;
+
+		bool popFront();
+
+		void remove(const DataType& data);
+
+		// The iterator must point to a value of this list
+		void erase(Iterator position);
+
+		Iterator begin() const
+		{
+			return head != nullptr ? Iterator(head, head->first) : end();
+		}
+
+		Iterator end() const
+		{
+			return Iterator();
+		}
+
+		DataType& operator [] (int index);
+
+		const DataType& operator [] (int index) const;
+
+		void operator + (const UnrolledList<DataType>& list);
+
+		UnrolledList<DataType>& operator = (const UnrolledList<DataType>& list);
+
+		UnrolledList<DataType>& operator = (UnrolledList<DataType>&& list);
+
+		// Removes everything but keeps a block for reuse
+		void clear();
+
+		// Removes everything and gives the memory back
+		void destroy();
+
+		~UnrolledList();
+	};
+
+	template <typename DataType>
+	void UnrolledList<DataType>::Iterator::operator++()
+	{
+		int next = slot + 1;
+
+		while (next < block->end && !block->isUsed(next))
+		{
+			++next;
+		}
+
+		if (next < block->end)
+		{
+			slot = next;
+			return;
+		}
+
+		block = block->next;
+		slot = block != nullptr ? block->first : 0;
+	}
+
+	template <typename DataType>
+	typename UnrolledList<DataType>::Block* UnrolledList<DataType>::createBlock()
+	{
+		Block* block = spare;
+
+		if (block != nullptr)
+		{
+			spare = nullptr;
+		}
+		else
+		{
+			block = new Block();
+		}
+
+		block->next = nullptr;
+		block->prev = nullptr;
+		block->used = 0;
+		block->count = 0;
+
+		return block;
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::releaseBlock(Block* block)
+	{
+		if (lastBlock == block)
+		{
+			lastBlock = nullptr;
+		}
+
+		if (spare == nullptr)
+		{
+			spare = block;
+		}
+		else
+		{
+			delete block;
+		}
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::changedCount(Block* block)
+	{
+		// Only the blocks after it move
+		if (!directoryStale && block->index + 1 < staleFrom)
+		{
+			staleFrom = block->index + 1;
+		}
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::refresh() const
+	{
+		if (directoryStale)
+		{
+			directory.clear();
+
+			for (Block* block = head; block != nullptr; block = block->next)
+			{
+				block->index = (int)directory.size();
+				directory.push_back(block);
+			}
+
+			directoryStale = false;
+			staleFrom = 0;
+		}
+
+		int start = staleFrom == 0 ? 0 : directory[staleFrom - 1]->start + directory[staleFrom - 1]->count;
+
+		for (int i = staleFrom; i < (int)directory.size(); ++i)
+		{
+			directory[i]->start = start;
+			start += directory[i]->count;
+		}
+
+		staleFrom = (int)directory.size();
+	}
+
+	template <typename DataType>
+	DataType* UnrolledList<DataType>::locate(int index) const
+	{
+		refresh();
+
+		Block* block = lastBlock;
+
+		if (block == nullptr || index < block->start || index >= block->start + block->count)
+		{
+			// Binary search for the last block starting at or before index
+			int low = 0;
+			int high = (int)directory.size() - 1;
+
+			while (low < high)
+			{
+				int middle = (low + high + 1) / 2;
+
+				if (directory[middle]->start <= index)
+				{
+					low = middle;
+				}
+				else
+				{
+					high = middle - 1;
+				}
+			}
+
+			block = directory[low];
+			lastBlock = block;
+		}
+
+		int rank = index - block->start;
+
+		if (block->end - block->first == block->count)
+		{
+			return block->slot(block->first + rank);
+		}
+
+		for (int i = block->first; ; ++i)
+		{
+			if (block->isUsed(i) && rank-- == 0)
+			{
+				return block->slot(i);
+			}
+		}
+	}
+
+	template <typename DataType>
+	UnrolledList<DataType>::UnrolledList() {}
+
+	template <typename DataType>
+	UnrolledList<DataType>::UnrolledList(const UnrolledList<DataType>& list)
+	{
+		*this + list;
+	}
+
+	template <typename DataType>
+	UnrolledList<DataType>::UnrolledList(UnrolledList<DataType>&& list)
+	{
+		*this = std::move(list);
+	}
+
+	template <typename DataType>
+	int UnrolledList<DataType>::getSize() const
+	{
+		return size;
+	}
+
+	template <typename DataType>
+	std::size_t UnrolledList<DataType>::getBytes() const
+	{
+		std::size_t blocks = spare != nullptr ? 1 : 0;
+
+		for (Block* block = head; block != nullptr; block = block->next)
+		{
+			++blocks;
+		}
+
+		return blocks * sizeof(Block) + directory.capacity() * sizeof(Block*);
+	}
+
+	template <typename DataType>
+	typename UnrolledList<DataType>::Iterator UnrolledList<DataType>::pushFront(const DataType& data)
+	{
+		return emplaceFront(data);
+	}
+
+	template <typename DataType>
+	typename UnrolledList<DataType>::Iterator UnrolledList<DataType>::pushBack(const DataType& data)
+	{
+		return emplaceBack(data);
+	}
+
+	template <typename DataType>
+	template <typename... Args>
+	typename UnrolledList<DataType>::Iterator UnrolledList<DataType>::emplaceFront(Args&&... args)
+	{
+		if (head != nullptr && head->first > 0)
+		{
+			int slot = head->first - 1;
+			new (head->slot(slot)) DataType(std::forward<Args>(args)...);
+
+			head->first = slot;
+			head->used |= std::uint64_t(1) << slot;
+			head->count++;
+			size++;
+			changedCount(head);
+
+			return Iterator(head, slot);
+		}
+
+		// New blocks in front fill from their last slot
+		Block* block = createBlock();
+		int slot = blockCapacity - 1;
+
+		try
+		{
+			new (block->slot(slot)) DataType(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			releaseBlock(block);
+			throw;
+		}
+
+		block->first = slot;
+		block->end = blockCapacity;
+		block->used = std::uint64_t(1) << slot;
+		block->count = 1;
+		block->next = head;
+
+		if (head != nullptr)
+		{
+			head->prev = block;
+		}
+		else
+		{
+			tail = block;
+		}
+
+		head = block;
+		size++;
+		directoryStale = true;
+
+		return Iterator(block, slot);
+	}
+
+	template <typename DataType>
+	template <typename... Args>
+	typename UnrolledList<DataType>::Iterator UnrolledList<DataType>::emplaceBack(Args&&... args)
+	{
+		if (tail != nullptr && tail->end < blockCapacity)
+		{
+			int slot = tail->end;
+			new (tail->slot(slot)) DataType(std::forward<Args>(args)...);
+
+			tail->end = slot + 1;
+			tail->used |= std::uint64_t(1) << slot;
+			tail->count++;
+			size++;
+			changedCount(tail);
+
+			return Iterator(tail, slot);
+		}
+
+		Block* block = createBlock();
+
+		try
+		{
+			new (block->slot(0)) DataType(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			releaseBlock(block);
+			throw;
+		}
+
+		block->first = 0;
+		block->end = 1;
+		block->used = 1;
+		block->count = 1;
+		block->prev = tail;
+
+		if (tail != nullptr)
+		{
+			tail->next = block;
+		}
+		else
+		{
+			head = block;
+		}
+
+		tail = block;
+		size++;
+		directoryStale = true;
+
+		return Iterator(block, 0);
+	}
+
+	template <typename DataType>
+	DataType* UnrolledList<DataType>::find(const DataType& data) const
+	{
+		for (DataType& value : *this)
+		{
+			if (value == data)
+			{
+				return &value;
+			}
+		}
+
+		return nullptr;
+	}
+
+	template <typename DataType>
+	bool UnrolledList<DataType>::popFront()
+	{
+		if (size == 0)
+		{
+			return false;
+		}
+
+		erase(begin());
+
+		return true;
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::remove(const DataType& data)
+	{
+		if (size == 0)
+		{
+			throw "List is empty";
+		}
+
+		for (Iterator it = begin(); it != end(); ++it)
+		{
+			if (*it == data)
+			{
+				erase(it);
+
+				return;
+			}
+		}
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::erase(Iterator position)
+	{
+		Block* block = position.block;
+		int slot = position.slot;
+
+		block->slot(slot)->~DataType();
+		block->used &= ~(std::uint64_t(1) << slot);
+		block->count--;
+		size--;
+
+		if (block->count == 0)
+		{
+			if (block->prev != nullptr)
+			{
+				block->prev->next = block->next;
+			}
+			else
+			{
+				head = block->next;
+			}
+
+			if (block->next != nullptr)
+			{
+				block->next->prev = block->prev;
+			}
+			else
+			{
+				tail = block->prev;
+			}
+
+			releaseBlock(block);
+			directoryStale = true;
+
+			return;
+		}
+
+		// Keep first and end on values, so the ends of the list can be pushed into again
+		while (!block->isUsed(block->first))
+		{
+			block->first++;
+		}
+
+		while (!block->isUsed(block->end - 1))
+		{
+			block->end--;
+		}
+
+		changedCount(block);
+	}
+
+	template <typename DataType>
+	DataType& UnrolledList<DataType>::operator [] (int index)
+	{
+		return *locate(index);
+	}
+
+	template <typename DataType>
+	const DataType& UnrolledList<DataType>::operator [] (int index) const
+	{
+		return *locate(index);
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::operator + (const UnrolledList<DataType>& list)
+	{
+		for (const DataType& value : list)
+		{
+			pushBack(value);
+		}
+	}
+
+	template <typename DataType>
+	UnrolledList<DataType>& UnrolledList<DataType>::operator = (const UnrolledList<DataType>& list)
+	{
+		if (this == &list)
+		{
+			return *this;
+		}
+
+		clear();
+		*this + list;
+
+		return *this;
+	}
+
+	template <typename DataType>
+	UnrolledList<DataType>& UnrolledList<DataType>::operator = (UnrolledList<DataType>&& list)
+	{
+		if (this == &list)
+		{
+			return *this;
+		}
+
+		destroy();
+
+		head = list.head;
+		tail = list.tail;
+		size = list.size;
+		spare = list.spare;
+		directoryStale = true;
+
+		list.head = nullptr;
+		list.tail = nullptr;
+		list.size = 0;
+		list.spare = nullptr;
+		list.directoryStale = true;
+		list.lastBlock = nullptr;
+
+		return *this;
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::clear()
+	{
+		Block* block = head;
+
+		while (block != nullptr)
+		{
+			Block* next = block->next;
+
+			for (int i = block->first; i < block->end; ++i)
+			{
+				if (block->isUsed(i))
+				{
+					block->slot(i)->~DataType();
+				}
+			}
+
+			releaseBlock(block);
+			block = next;
+		}
+
+		head = nullptr;
+		tail = nullptr;
+		size = 0;
+		directoryStale = true;
+		lastBlock = nullptr;
+	}
+
+	template <typename DataType>
+	void UnrolledList<DataType>::destroy()
+	{
+		clear();
+
+		delete spare;
+		spare = nullptr;
+		directory.clear();
+		directory.shrink_to_fit();
+	}
+
+	template <typename DataType>
+	UnrolledList<DataType>::~UnrolledList()
+	{
+		destroy();
+	}
+}
+
+#endif // UNROLLEDLIST_H